@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include "Allocator.h"
+#include "SegmentRange.h"
+
+
+// one writer, many readers over a single shared ring; every reader owns a cursor
+// and sees every element, the writer never overtakes the slowest registered reader
+template<typename T, typename Alloc=CAllocator<T>>
+class CBroadcastCirtucalBuffer {
+public:
+
+    using value_type = T;
+    using const_reference = const T&;
+    using reader_id = size_t;
+
+    using allocator_type = Alloc;
+
+    explicit CBroadcastCirtucalBuffer(size_t n, size_t max_readers = 16)
+        : capacity_(n)
+        , max_readers_(max_readers)
+        , alloc_(Alloc())
+    {
+        if (capacity_ == 0) {
+            throw std::invalid_argument("capacity must be positive");
+        }
+
+        data_ = alloc_.allocate(capacity_);
+        std::uninitialized_value_construct_n(data_, capacity_);
+        readers_ = new ReaderCursor[max_readers_];
+    }
+
+    CBroadcastCirtucalBuffer(const CBroadcastCirtucalBuffer&) = delete;
+    CBroadcastCirtucalBuffer& operator=(const CBroadcastCirtucalBuffer&) = delete;
+
+    ~CBroadcastCirtucalBuffer() {
+        delete[] readers_;
+        std::destroy_n(data_, capacity_);
+        alloc_.deallocate(data_, capacity_);
+    }
+
+    // new readers start at the current writer sequence. the writer already gates on a
+    // claimed cursor, so it cannot lap the sequence read here before it is published
+    reader_id register_reader() {
+        for (size_t i = 0; i < max_readers_; i++) {
+            int state = kFree;
+            if (readers_[i].state.compare_exchange_strong(state, kClaimed, std::memory_order_seq_cst)) {
+                readers_[i].sequence.store(write_seq_.load(std::memory_order_seq_cst), std::memory_order_release);
+                readers_[i].claimed = 0;
+                readers_[i].state.store(kActive, std::memory_order_release);
+                return i;
+            }
+        }
+
+        throw std::length_error("too many readers");
+    }
+
+    void unregister_reader(reader_id reader) {
+        cursor(reader).state.store(kFree, std::memory_order_release);
+    }
+
+    // writer side, fails instead of overwriting data the slowest reader has not seen yet
+    bool try_push_back(const_reference val) {
+        uint64_t seq = write_seq_.load(std::memory_order_relaxed);
+        if (freeSlots(seq) == 0) {
+            return false;
+        }
+
+        data_[seq % capacity_] = val;
+        write_seq_.store(seq + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // writes as much of [first, last) as fits and publishes it at once
+    template<typename SmthIterator>
+    size_t try_push_back(SmthIterator first, SmthIterator last) {
+        uint64_t seq = write_seq_.load(std::memory_order_relaxed);
+        size_t n = freeSlots(seq);
+
+        size_t written = 0;
+        while (written < n && first != last) {
+            data_[(seq + written) % capacity_] = *first;
+            ++first;
+            ++written;
+        }
+
+        if (written != 0) {
+            write_seq_.store(seq + written, std::memory_order_release);
+        }
+
+        return written;
+    }
+
+    void push_back(const_reference val) {
+        while (!try_push_back(val)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // reader side, everything published but not yet released by this reader
+    [[nodiscard]] CSegmentRange<const T> claim(reader_id reader) {
+        uint64_t from = cursor(reader).sequence.load(std::memory_order_relaxed);
+        uint64_t to = write_seq_.load(std::memory_order_acquire);
+
+        size_t n = to - from;
+        cursor(reader).claimed = n;
+
+        size_t pos = from % capacity_;
+        if (pos + n <= capacity_) {
+            return {std::span<const T>(data_ + pos, n), std::span<const T>()};
+        }
+
+        return {std::span<const T>(data_ + pos, capacity_ - pos), std::span<const T>(data_, pos + n - capacity_)};
+    }
+
+    // hands the first n claimed elements back to the writer
+    void release(reader_id reader, size_t n) {
+        if (n > cursor(reader).claimed) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        cursor(reader).claimed -= n;
+        uint64_t seq = cursor(reader).sequence.load(std::memory_order_relaxed);
+        cursor(reader).sequence.store(seq + n, std::memory_order_release);
+    }
+
+    [[nodiscard]] size_t available(reader_id reader) const {
+        return write_seq_.load(std::memory_order_acquire) - cursor(reader).sequence.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] uint64_t sequence() const {
+        return write_seq_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_;
+    }
+
+    [[nodiscard]] size_t max_readers() const {
+        return max_readers_;
+    }
+
+    allocator_type get_allocator() const {
+        return alloc_;
+    }
+
+private:
+
+    static constexpr int kFree = 0;
+    static constexpr int kClaimed = 1;
+    static constexpr int kActive = 2;
+
+    struct alignas(64) ReaderCursor {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int> state{kFree};
+
+        // reader thread only, how much of the last claim is still unreleased
+        size_t claimed = 0;
+    };
+
+    // readers_ is a raw pointer, so const members go through the const overload
+    // to keep them from writing a cursor
+    [[nodiscard]] ReaderCursor& cursor(reader_id reader) {
+        return readers_[reader];
+    }
+
+    [[nodiscard]] const ReaderCursor& cursor(reader_id reader) const {
+        return readers_[reader];
+    }
+
+    // the slowest reader is only rescanned once the cached value stops the writer
+    [[nodiscard]] size_t freeSlots(uint64_t seq) {
+        if (seq - gating_seq_ >= capacity_) {
+            gating_seq_ = slowestReader(seq);
+        }
+
+        return capacity_ - (seq - gating_seq_);
+    }
+
+    // a claimed cursor may still hold a stale sequence from its previous owner;
+    // clamping it to one lap behind stops the writer until the real one is published
+    [[nodiscard]] uint64_t slowestReader(uint64_t seq) const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        uint64_t min = seq;
+        for (size_t i = 0; i < max_readers_; i++) {
+            if (readers_[i].state.load(std::memory_order_acquire) != kFree) {
+                uint64_t reader = readers_[i].sequence.load(std::memory_order_acquire);
+                min = std::min(min, (seq - reader > capacity_) ? seq - capacity_ : reader);
+            }
+        }
+
+        return min;
+    }
+
+    alignas(64) std::atomic<uint64_t> write_seq_{0};
+    alignas(64) uint64_t gating_seq_ = 0;
+
+    T* data_;
+    size_t capacity_;
+
+    ReaderCursor* readers_;
+    size_t max_readers_;
+
+    Alloc alloc_;
+
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include "CirtucalBuffer.h"
+
+
+template<typename T, typename Time = uint64_t>
+struct CSample {
+    Time time;
+    T value;
+};
+
+
+// aggregators fold a block of finer samples into one coarser sample
+template<typename T>
+class CMeanAggregator {
+public:
+    void add(const T& val) {
+        sum_ = (count_ == 0) ? val : sum_ + val;
+        ++count_;
+    }
+
+    [[nodiscard]] T get() const {
+        return sum_ / static_cast<T>(count_);
+    }
+
+    void reset() {
+        count_ = 0;
+    }
+
+private:
+    T sum_{};
+    size_t count_ = 0;
+};
+
+template<typename T>
+class CMinAggregator {
+public:
+    void add(const T& val) {
+        min_ = empty_ ? val : std::min(min_, val);
+        empty_ = false;
+    }
+
+    [[nodiscard]] T get() const {
+        return min_;
+    }
+
+    void reset() {
+        empty_ = true;
+    }
+
+private:
+    T min_{};
+    bool empty_ = true;
+};
+
+template<typename T>
+class CMaxAggregator {
+public:
+    void add(const T& val) {
+        max_ = empty_ ? val : std::max(max_, val);
+        empty_ = false;
+    }
+
+    [[nodiscard]] T get() const {
+        return max_;
+    }
+
+    void reset() {
+        empty_ = true;
+    }
+
+private:
+    T max_{};
+    bool empty_ = true;
+};
+
+template<typename T>
+class CLastAggregator {
+public:
+    void add(const T& val) {
+        last_ = val;
+    }
+
+    [[nodiscard]] T get() const {
+        return last_;
+    }
+
+    void reset() {}
+
+private:
+    T last_{};
+};
+
+
+// capacity in samples, factor is how many samples of the previous tier become one here
+struct CCascadeTier {
+    size_t capacity;
+    size_t factor;
+};
+
+
+// round-robin-database style tiers: raw samples in tier 0, every completed block
+// of a tier is folded into one sample of the next, coarser one
+template<typename T, typename Aggregator = CMeanAggregator<T>, typename Time = uint64_t>
+class CCascadeCirtucalBuffer {
+public:
+
+    using value_type = T;
+    using sample_type = CSample<T, Time>;
+    using tier_type = CCirtucalBuffer<sample_type>;
+
+    struct QueryResult {
+        size_t tier;
+        CSegmentRange<sample_type> samples;
+    };
+
+    // the factor of the first tier is ignored, it holds the raw samples
+    CCascadeCirtucalBuffer(const std::initializer_list<CCascadeTier>& tiers)
+        : tiers_count_(tiers.size())
+    {
+        if (tiers_count_ == 0) {
+            throw std::invalid_argument("at least one tier is required");
+        }
+
+        for (const CCascadeTier* tier = tiers.begin() + 1; tier != tiers.end(); ++tier) {
+            if (tier->factor == 0) {
+                throw std::invalid_argument("tier factor must be positive");
+            }
+        }
+
+        tiers_.reset(new Tier[tiers_count_]);
+        size_t i = 0;
+        for (const CCascadeTier& tier: tiers) {
+            tiers_[i].samples = tier_type(tier.capacity);
+            tiers_[i].factor = tier.factor;
+            ++i;
+        }
+    }
+
+    CCascadeCirtucalBuffer(const CCascadeCirtucalBuffer&) = delete;
+    CCascadeCirtucalBuffer& operator=(const CCascadeCirtucalBuffer&) = delete;
+
+    // samples have to come in non-decreasing time order
+    void push_back(const Time& time, const T& val) {
+        pushTier(0, sample_type{time, val});
+    }
+
+    [[nodiscard]] size_t tiers() const {
+        return tiers_count_;
+    }
+
+    [[nodiscard]] const tier_type& tier(size_t i) const {
+        if (i >= tiers_count_) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return tiers_[i].samples;
+    }
+
+    // samples with from <= time <= to from the finest tier that still reaches back to from,
+    // or from the coarsest non-empty tier if none does
+    [[nodiscard]] QueryResult query(const Time& from, const Time& to) const {
+        size_t chosen = tiers_count_;
+        for (size_t i = 0; i < tiers_count_; i++) {
+            const tier_type& samples = tiers_[i].samples;
+            if (samples.empty()) {
+                continue;
+            }
+
+            chosen = i;
+            if (!(from < samples.front().time)) {
+                break;
+            }
+        }
+
+        if (chosen == tiers_count_) {
+            return {0, CSegmentRange<sample_type>()};
+        }
+
+        return {chosen, tiers_[chosen].samples.range(from, to, &sample_type::time)};
+    }
+
+private:
+
+    struct Tier {
+        tier_type samples;
+        size_t factor = 0;
+
+        // block of this tier's samples that is being folded into the next one
+        Aggregator aggregator;
+        size_t pending = 0;
+        Time block_start{};
+    };
+
+    void pushTier(size_t i, const sample_type& sample) {
+        Tier& tier = tiers_[i];
+        tier.samples.push_back(sample);
+
+        if (i + 1 == tiers_count_) {
+            return;
+        }
+
+        if (tier.pending == 0) {
+            tier.block_start = sample.time;
+        }
+        tier.aggregator.add(sample.value);
+
+        if (++tier.pending == tiers_[i + 1].factor) {
+            sample_type folded{tier.block_start, tier.aggregator.get()};
+            tier.aggregator.reset();
+            tier.pending = 0;
+
+            pushTier(i + 1, folded);
+        }
+    }
+
+    std::unique_ptr<Tier[]> tiers_;
+    size_t tiers_count_;
+
+};
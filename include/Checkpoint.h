@@ -0,0 +1,614 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CirtucalBuffer.h"
+
+
+// binary snapshot of a ring: header, then the live elements in logical order.
+// trivially copyable contents go out in at most two bulk writes, everything
+// else goes through a codec
+
+struct CCheckpointHeader {
+    static constexpr uint32_t kMagic = 0x46554243; // "CBUF"
+    static constexpr uint32_t kVersion = 2;
+
+    static constexpr uint16_t kFull = 0;
+    static constexpr uint16_t kDelta = 1;
+
+    uint32_t magic = kMagic;
+    uint16_t version = kVersion;
+    uint16_t kind = kFull;
+    uint64_t capacity = 0;
+    uint64_t size = 0;
+    uint64_t element_size = 0;  // 0 for codecs with variable-sized output
+    uint64_t count = 0;         // elements in the payload, size or the appended tail of a delta
+    uint64_t checksum = 0;
+    uint64_t generation = 0;    // 0 for snapshots of untracked buffers
+    uint64_t base = 0;          // generation a delta has to be applied to
+};
+
+
+// streaming 64-bit hash over the payload, independent of how the bytes are split into writes
+class CChecksum {
+public:
+
+    void update(const void* data, size_t n) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+
+        while (n != 0 && pending_size_ != 0) {
+            pushByte(*bytes++);
+            --n;
+        }
+
+        while (n >= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            mix(word);
+            bytes += sizeof(word);
+            n -= sizeof(word);
+        }
+
+        while (n != 0) {
+            pushByte(*bytes++);
+            --n;
+        }
+    }
+
+    [[nodiscard]] uint64_t value() const {
+        CChecksum tail = *this;
+        tail.mix(tail.pending_ ^ (static_cast<uint64_t>(tail.pending_size_) << 56));
+
+        return tail.hash_;
+    }
+
+private:
+
+    void pushByte(unsigned char byte) {
+        pending_ |= static_cast<uint64_t>(byte) << (8 * pending_size_);
+        if (++pending_size_ == sizeof(uint64_t)) {
+            mix(pending_);
+            pending_ = 0;
+            pending_size_ = 0;
+        }
+    }
+
+    void mix(uint64_t word) {
+        hash_ = (hash_ ^ word) * 0x100000001b3ULL;
+        hash_ ^= hash_ >> 29;
+    }
+
+    uint64_t hash_ = 0xcbf29ce484222325ULL;
+    uint64_t pending_ = 0;
+    size_t pending_size_ = 0;
+};
+
+
+class CStreamSink {
+public:
+    explicit CStreamSink(std::ostream& os)
+        : os_(os) {}
+
+    void write(const void* data, size_t n) {
+        os_.write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+        if (!os_) {
+            throw std::runtime_error("checkpoint write failed");
+        }
+    }
+
+private:
+    std::ostream& os_;
+};
+
+class CFdSink {
+public:
+    explicit CFdSink(int fd)
+        : fd_(fd) {}
+
+    void write(const void* data, size_t n) {
+        const char* bytes = static_cast<const char*>(data);
+        while (n != 0) {
+            ssize_t written = ::write(fd_, bytes, n);
+            if (written <= 0) {
+                throw std::runtime_error("checkpoint write failed");
+            }
+            bytes += written;
+            n -= written;
+        }
+    }
+
+private:
+    int fd_;
+};
+
+class CHashSink {
+public:
+    void write(const void* data, size_t n) {
+        checksum_.update(data, n);
+    }
+
+    [[nodiscard]] uint64_t value() const {
+        return checksum_.value();
+    }
+
+private:
+    CChecksum checksum_;
+};
+
+class CStreamSource {
+public:
+    explicit CStreamSource(std::istream& is)
+        : is_(is) {}
+
+    void read(void* data, size_t n) {
+        is_.read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+        if (!is_) {
+            throw std::runtime_error("checkpoint is truncated");
+        }
+    }
+
+    // bytes left in a seekable stream, SIZE_MAX if that can't be told
+    [[nodiscard]] size_t remaining() {
+        std::streampos here = is_.tellg();
+        if (here == std::streampos(-1)) {
+            return SIZE_MAX;
+        }
+
+        is_.seekg(0, std::ios::end);
+        std::streampos end = is_.tellg();
+        is_.clear();
+        is_.seekg(here);
+
+        return (end == std::streampos(-1) || end < here) ? SIZE_MAX : static_cast<size_t>(end - here);
+    }
+
+private:
+    std::istream& is_;
+};
+
+class CFdSource {
+public:
+    explicit CFdSource(int fd)
+        : fd_(fd) {}
+
+    void read(void* data, size_t n) {
+        char* bytes = static_cast<char*>(data);
+        while (n != 0) {
+            ssize_t got = ::read(fd_, bytes, n);
+            if (got <= 0) {
+                throw std::runtime_error("checkpoint is truncated");
+            }
+            bytes += got;
+            n -= got;
+        }
+    }
+
+    // bytes left in a regular file, SIZE_MAX for pipes and sockets
+    [[nodiscard]] size_t remaining() const {
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+            return SIZE_MAX;
+        }
+
+        off_t here = ::lseek(fd_, 0, SEEK_CUR);
+        if (here < 0) {
+            return SIZE_MAX;
+        }
+
+        return (here >= st.st_size) ? 0 : static_cast<size_t>(st.st_size - here);
+    }
+
+private:
+    int fd_;
+};
+
+// checksums everything read through it
+template<typename Source>
+class CHashSource {
+public:
+    explicit CHashSource(Source& source)
+        : source_(source) {}
+
+    void read(void* data, size_t n) {
+        source_.read(data, n);
+        checksum_.update(data, n);
+    }
+
+    [[nodiscard]] uint64_t value() const {
+        return checksum_.value();
+    }
+
+private:
+    Source& source_;
+    CChecksum checksum_;
+};
+
+
+// default codec, raw bytes; kBulk lets whole segments be written and read at once
+template<typename T>
+struct CTrivialCodec {
+    static_assert(std::is_trivially_copyable_v<T>, "use a custom codec for non trivially copyable types");
+
+    static constexpr bool kBulk = true;
+
+    template<typename Sink>
+    static void encode(Sink& out, const T& val) {
+        out.write(&val, sizeof(T));
+    }
+
+    template<typename Source>
+    static void decode(Source& in, T& val) {
+        in.read(&val, sizeof(T));
+    }
+};
+
+
+// remembers what was appended since the last checkpoint, so save_incremental
+// only writes the new tail. the ring is kept private and every mutator is
+// tracked: pushes at the back and pops at the front keep the next checkpoint
+// a delta, anything else makes it a full one
+template<typename T>
+class CCheckpointCirtucalBuffer {
+public:
+    using value_type = T;
+    using const_reference = const T&;
+    using const_iterator = typename CCirtucalBuffer<T>::const_iterator;
+
+    explicit CCheckpointCirtucalBuffer(size_t n)
+        : buffer_(n)
+    {}
+
+    CCheckpointCirtucalBuffer(const std::initializer_list<value_type>& il)
+        : buffer_(il)
+    {}
+
+    void push_back(const_reference val) {
+        buffer_.push_back(val);
+        ++appended_;
+    }
+
+    void pop_front() {
+        buffer_.pop_front();
+    }
+
+    void push_front(const_reference val) {
+        buffer_.push_front(val);
+        dirty_ = true;
+    }
+
+    void pop_back() {
+        buffer_.pop_back();
+        dirty_ = true;
+    }
+
+    void clear() {
+        buffer_.clear();
+        dirty_ = true;
+    }
+
+    void resize(size_t n) {
+        buffer_.resize(n);
+        dirty_ = true;
+    }
+
+    // any other change, insert, erase, assign or writes to elements:
+    // fn gets the ring itself and the next checkpoint is a full one
+    template<typename Fn>
+    void modify(Fn fn) {
+        dirty_ = true;
+        fn(buffer_);
+    }
+
+    [[nodiscard]] const_reference operator[](size_t n) const {
+        return buffer_[n];
+    }
+
+    [[nodiscard]] const_reference at(size_t n) const {
+        return buffer_.at(n);
+    }
+
+    [[nodiscard]] const_reference front() const {
+        return buffer_.front();
+    }
+
+    [[nodiscard]] const_reference back() const {
+        return buffer_.back();
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return buffer_.cbegin();
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return buffer_.cend();
+    }
+
+    [[nodiscard]] CSegmentRange<const value_type> segments() const {
+        CSegmentRange<value_type> pieces = buffer_.segments();
+        return {pieces.first(), pieces.second()};
+    }
+
+    [[nodiscard]] size_t size() const {
+        return buffer_.size();
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return buffer_.capacity();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return buffer_.empty();
+    }
+
+    [[nodiscard]] bool full() const {
+        return buffer_.full();
+    }
+
+    bool operator==(const CCirtucalBuffer<T>& other) const {
+        return buffer_ == other;
+    }
+
+    [[nodiscard]] bool dirty() const {
+        return dirty_;
+    }
+
+    [[nodiscard]] size_t appended_since_checkpoint() const {
+        return appended_;
+    }
+
+    // generation of the last checkpoint written from or loaded into this buffer, 0 if none
+    [[nodiscard]] uint64_t generation() const {
+        return generation_;
+    }
+
+private:
+    template<typename, typename>
+    friend class CCheckpoint;
+
+    void markCheckpoint(uint64_t generation) {
+        generation_ = generation;
+        appended_ = 0;
+        dirty_ = (generation == 0);
+    }
+
+    CCirtucalBuffer<T> buffer_;
+    size_t appended_ = 0;
+    uint64_t generation_ = 0;
+    bool dirty_ = true;
+};
+
+
+template<typename T, typename Codec = CTrivialCodec<T>>
+class CCheckpoint {
+public:
+
+    template<typename Alloc, size_t N>
+    static void save(const CCirtucalBuffer<T, Alloc, N>& buffer, std::ostream& os) {
+        CStreamSink sink(os);
+        saveTo(buffer, sink, fullHeader(buffer, 0));
+    }
+
+    template<typename Alloc, size_t N>
+    static void save(const CCirtucalBuffer<T, Alloc, N>& buffer, int fd) {
+        CFdSink sink(fd);
+        saveTo(buffer, sink, fullHeader(buffer, 0));
+    }
+
+    // writes only the elements appended since the previous checkpoint of this buffer,
+    // falls back to a full snapshot when that is not possible
+    static void save_incremental(CCheckpointCirtucalBuffer<T>& buffer, std::ostream& os) {
+        CStreamSink sink(os);
+        saveIncrementalTo(buffer, sink);
+    }
+
+    static void save_incremental(CCheckpointCirtucalBuffer<T>& buffer, int fd) {
+        CFdSink sink(fd);
+        saveIncrementalTo(buffer, sink);
+    }
+
+    // the header comes from outside, so loads refuse rings larger than max_capacity
+    // before allocating anything
+    static constexpr size_t kDefaultMaxCapacity = (size_t(1) << 30) / sizeof(T);
+
+    // only full snapshots, a plain ring can't tell which checkpoint a delta builds on
+    template<typename Alloc, size_t N>
+    static void load(CCirtucalBuffer<T, Alloc, N>& buffer, std::istream& is, size_t max_capacity = kDefaultMaxCapacity) {
+        CStreamSource source(is);
+        loadFrom(buffer, source, max_capacity);
+    }
+
+    template<typename Alloc, size_t N>
+    static void load(CCirtucalBuffer<T, Alloc, N>& buffer, int fd, size_t max_capacity = kDefaultMaxCapacity) {
+        CFdSource source(fd);
+        loadFrom(buffer, source, max_capacity);
+    }
+
+    // a full snapshot replaces the buffer, a delta is applied on top of it
+    // if it was taken right after the checkpoint the buffer is at
+    static void load(CCheckpointCirtucalBuffer<T>& buffer, std::istream& is, size_t max_capacity = kDefaultMaxCapacity) {
+        CStreamSource source(is);
+        loadFrom(buffer, source, max_capacity);
+    }
+
+    static void load(CCheckpointCirtucalBuffer<T>& buffer, int fd, size_t max_capacity = kDefaultMaxCapacity) {
+        CFdSource source(fd);
+        loadFrom(buffer, source, max_capacity);
+    }
+
+private:
+
+    static constexpr bool kBulk = requires { requires Codec::kBulk; };
+
+    static uint64_t elementSize() {
+        if constexpr (kBulk) {
+            return sizeof(T);
+        } else {
+            return 0;
+        }
+    }
+
+    // full snapshots of tracked buffers start a new chain of random generations,
+    // so a delta can't be applied on top of another buffer's checkpoint
+    static uint64_t newGeneration() {
+        std::random_device random;
+        uint64_t generation = (static_cast<uint64_t>(random()) << 32) ^ random();
+
+        return (generation == 0) ? 1 : generation;
+    }
+
+    template<typename Buffer>
+    static CCheckpointHeader fullHeader(const Buffer& buffer, uint64_t generation) {
+        CCheckpointHeader header;
+        header.kind = CCheckpointHeader::kFull;
+        header.count = buffer.size();
+        header.generation = generation;
+
+        return header;
+    }
+
+    // fills in everything but kind, count and the generations
+    template<typename Buffer, typename Sink>
+    static void saveTo(const Buffer& buffer, Sink& sink, CCheckpointHeader header) {
+        auto payload = buffer.segments().subrange(buffer.size() - header.count, buffer.size());
+
+        header.capacity = buffer.capacity();
+        header.size = buffer.size();
+        header.element_size = elementSize();
+
+        if constexpr (kBulk) {
+            CChecksum checksum;
+            checksum.update(payload.first().data(), payload.first().size_bytes());
+            checksum.update(payload.second().data(), payload.second().size_bytes());
+            header.checksum = checksum.value();
+
+            sink.write(&header, sizeof(header));
+            sink.write(payload.first().data(), payload.first().size_bytes());
+            sink.write(payload.second().data(), payload.second().size_bytes());
+        } else {
+            // codecs are run twice, the header has to carry the checksum before the payload
+            CHashSink hash;
+            for (const T& val: payload) {
+                Codec::encode(hash, val);
+            }
+            header.checksum = hash.value();
+
+            sink.write(&header, sizeof(header));
+            for (const T& val: payload) {
+                Codec::encode(sink, val);
+            }
+        }
+    }
+
+    template<typename Sink>
+    static void saveIncrementalTo(CCheckpointCirtucalBuffer<T>& buffer, Sink& sink) {
+        CCheckpointHeader header;
+        if (buffer.dirty() || buffer.appended_since_checkpoint() > buffer.size()) {
+            header = fullHeader(buffer, newGeneration());
+        } else {
+            header.kind = CCheckpointHeader::kDelta;
+            header.count = buffer.appended_since_checkpoint();
+            header.base = buffer.generation();
+            header.generation = buffer.generation() + 1;
+        }
+
+        saveTo(buffer, sink, header);
+        buffer.markCheckpoint(header.generation);
+    }
+
+    template<typename Source>
+    static CCheckpointHeader readHeader(Source& source, size_t max_capacity) {
+        CCheckpointHeader header;
+        source.read(&header, sizeof(header));
+
+        if (header.magic != CCheckpointHeader::kMagic || header.version != CCheckpointHeader::kVersion) {
+            throw std::runtime_error("not a buffer checkpoint");
+        }
+        if (header.element_size != elementSize()) {
+            throw std::runtime_error("checkpoint element size mismatch");
+        }
+        if (header.size > header.capacity || header.count > header.size) {
+            throw std::runtime_error("checkpoint header is corrupted");
+        }
+        if (header.kind != CCheckpointHeader::kFull && header.kind != CCheckpointHeader::kDelta) {
+            throw std::runtime_error("unknown checkpoint kind");
+        }
+        if (header.capacity > max_capacity) {
+            throw std::runtime_error("checkpoint capacity exceeds the limit");
+        }
+        if (header.element_size != 0 && header.count > source.remaining() / header.element_size) {
+            throw std::runtime_error("checkpoint is truncated");
+        }
+
+        return header;
+    }
+
+    template<typename Alloc, size_t N, typename Source>
+    static void loadFrom(CCirtucalBuffer<T, Alloc, N>& buffer, Source& source, size_t max_capacity) {
+        CCheckpointHeader header = readHeader(source, max_capacity);
+        if (header.kind != CCheckpointHeader::kFull) {
+            throw std::runtime_error("a delta checkpoint needs a tracked buffer");
+        }
+
+        CCirtucalBuffer<T, Alloc, N> fresh(header.capacity);
+        readPayload(source, header, fresh);
+        buffer.swap(fresh);
+    }
+
+    template<typename Source>
+    static void loadFrom(CCheckpointCirtucalBuffer<T>& buffer, Source& source, size_t max_capacity) {
+        CCheckpointHeader header = readHeader(source, max_capacity);
+
+        if (header.kind == CCheckpointHeader::kFull) {
+            CCirtucalBuffer<T> fresh(header.capacity);
+            readPayload(source, header, fresh);
+            buffer.buffer_.swap(fresh);
+        } else {
+            if (header.base != buffer.generation() || header.capacity != buffer.capacity()) {
+                throw std::runtime_error("delta checkpoint does not follow the buffer");
+            }
+
+            CCirtucalBuffer<T> tail(header.count);
+            readPayload(source, header, tail);
+            for (const T& val: tail.segments()) {
+                buffer.buffer_.push_back(val);
+            }
+            while (buffer.size() > header.size) {
+                buffer.buffer_.pop_front();
+            }
+        }
+
+        buffer.markCheckpoint(header.generation);
+    }
+
+    // reads header.count elements into the empty into and checks them against the header
+    template<typename Alloc, size_t N, typename Source>
+    static void readPayload(Source& source, const CCheckpointHeader& header, CCirtucalBuffer<T, Alloc, N>& into) {
+        CHashSource<Source> hashed(source);
+
+        if constexpr (kBulk) {
+            into.resize(header.count);
+            CSegmentRange<T> pieces = into.segments();
+            hashed.read(pieces.first().data(), pieces.first().size_bytes());
+            hashed.read(pieces.second().data(), pieces.second().size_bytes());
+        } else {
+            for (size_t i = 0; i < header.count; i++) {
+                T val;
+                Codec::decode(hashed, val);
+                into.push_back(val);
+            }
+        }
+
+        if (hashed.value() != header.checksum) {
+            throw std::runtime_error("checkpoint checksum mismatch");
+        }
+    }
+
+};
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "Allocator.h"
+#include "SegmentRange.h"
+
+
+// CCirtucalBufferExt semantics (the capacity doubles when a full buffer grows)
+// over fixed-size chunks held in a small ring of chunk pointers: growth only
+// appends chunks and nothing is copied, and chunks emptied at either end go
+// to a pool for reuse. references stay valid across pushes and pops at both
+// ends; iterators are logical indices like CCirtucalBufferExt's, so push_front
+// and pop_front shift what they point at, and insert and erase move elements
+template<typename T, size_t ChunkShift = 10, typename Alloc = CAllocator<T>>
+class CChunkedCirtucalBufferExt {
+public:
+
+    using value_type = T;
+    using pointer = T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = SegmentIterator<CChunkedCirtucalBufferExt, T>;
+    using const_iterator = SegmentIterator<CChunkedCirtucalBufferExt, const T>;
+
+    using allocator_type = Alloc;
+
+    static constexpr size_t kChunkSize = size_t(1) << ChunkShift;
+
+    explicit CChunkedCirtucalBufferExt(size_t n)
+        : capacity_(n)
+        , alloc_(Alloc())
+    {
+        allocateIndex(kInitialChunkSlots);
+    }
+
+    explicit CChunkedCirtucalBufferExt(size_t n, const_reference val)
+        : CChunkedCirtucalBufferExt(n)
+    {
+        for (size_t i = 0; i < n; i++) {
+            push_back(val);
+        }
+    }
+
+    CChunkedCirtucalBufferExt(const std::initializer_list<value_type>& il)
+        : CChunkedCirtucalBufferExt(il.size())
+    {
+        for (const_reference val: il) {
+            push_back(val);
+        }
+    }
+
+    CChunkedCirtucalBufferExt(const CChunkedCirtucalBufferExt& other)
+        : CChunkedCirtucalBufferExt(other.capacity_)
+    {
+        for (size_t i = 0; i < other.size_; i++) {
+            push_back(other.element(i));
+        }
+    }
+
+    ~CChunkedCirtucalBufferExt() {
+        clear();
+        for (size_t i = 0; i < chunk_count_; i++) {
+            alloc_.deallocate(chunkAt(i), kChunkSize);
+        }
+        shrink_to_fit();
+        delete[] chunks_;
+    }
+
+    CChunkedCirtucalBufferExt& operator=(const CChunkedCirtucalBufferExt& other) {
+        if (this != &other) {
+            clear();
+            capacity_ = other.capacity_;
+            for (size_t i = 0; i < other.size_; i++) {
+                push_back(other.element(i));
+            }
+        }
+
+        return *this;
+    }
+
+    bool operator==(const CChunkedCirtucalBufferExt& other) const {
+        if (size_ != other.size_) {
+            return false;
+        }
+
+        for (size_t i = 0; i < size_; i++) {
+            if (!(element(i) == other.element(i))) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const CChunkedCirtucalBufferExt& other) const {
+        return !operator==(other);
+    }
+
+    void push_back(const_reference val) {
+        twiceCapacity();
+
+        size_t pos = head_ + size_;
+        if ((pos >> ChunkShift) == chunk_count_) {
+            appendChunk();
+        }
+
+        new (slot(pos)) T(val);
+        ++size_;
+    }
+
+    void push_front(const_reference val) {
+        twiceCapacity();
+
+        if (head_ == 0) {
+            prependChunk();
+            head_ = kChunkSize;
+        }
+
+        new (slot(head_ - 1)) T(val);
+        --head_;
+        ++size_;
+    }
+
+    void pop_front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        std::destroy_at(slot(head_));
+        ++head_;
+        --size_;
+
+        if (head_ == kChunkSize || size_ == 0) {
+            releaseFrontChunk();
+            head_ = 0;
+        }
+    }
+
+    void pop_back() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        --size_;
+        size_t pos = head_ + size_;
+        std::destroy_at(slot(pos));
+
+        if ((pos & (kChunkSize - 1)) == 0 || size_ == 0) {
+            releaseBackChunk();
+            if (size_ == 0) {
+                head_ = 0;
+            }
+        }
+    }
+
+    void swap(CChunkedCirtucalBufferExt& other) {
+        std::swap(chunks_, other.chunks_);
+        std::swap(chunk_slots_, other.chunk_slots_);
+        std::swap(first_chunk_, other.first_chunk_);
+        std::swap(chunk_count_, other.chunk_count_);
+        std::swap(head_, other.head_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(pool_, other.pool_);
+        std::swap(pool_size_, other.pool_size_);
+        std::swap(alloc_, other.alloc_);
+    }
+
+    void resize(size_t n) {
+        while (size_ < n) {
+            push_back(value_type());
+        }
+        while (size_ > n) {
+            pop_back();
+        }
+    }
+
+    // elements from Where on move one place back
+    iterator insert(iterator Where, const_reference val) {
+        size_t n = Where - begin();
+        if (n > size_) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        value_type tmp(val);
+        push_back(tmp);
+        for (size_t i = size_ - 1; i > n; i--) {
+            element(i) = std::move(element(i - 1));
+        }
+        element(n) = std::move(tmp);
+
+        return iterator(this, n);
+    }
+
+    iterator insert(size_t Where, const_reference val) {
+        return insert(begin() + Where, val);
+    }
+
+    iterator erase(iterator Where) {
+        return erase(Where, Where + 1);
+    }
+
+    // elements after last move forward, the tail is destroyed
+    iterator erase(iterator first, iterator last) {
+        size_t from = first - begin();
+        size_t to = last - begin();
+        if (from > to || to > size_) {
+            return end();
+        }
+
+        for (size_t i = to; i < size_; i++) {
+            element(from + i - to) = std::move(element(i));
+        }
+        for (size_t i = from; i < to; i++) {
+            pop_back();
+        }
+
+        return iterator(this, from);
+    }
+
+    [[nodiscard]] reference front() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(0);
+    }
+
+    [[nodiscard]] reference back() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(size_ - 1);
+    }
+
+    // O(1), one shift and one mask away from the element
+    [[nodiscard]] reference operator[](size_t n) const {
+        if (n >= size_) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return element(n);
+    }
+
+    [[nodiscard]] reference at(size_t n) const {
+        return operator[](n);
+    }
+
+    [[nodiscard]] iterator begin() const {
+        return iterator(this, 0);
+    }
+
+    [[nodiscard]] iterator end() const {
+        return iterator(this, size_);
+    }
+
+    [[nodiscard]] const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+
+    [[nodiscard]] const_iterator cend() const {
+        return const_iterator(this, size_);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] bool full() const {
+        return size_ == capacity_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_;
+    }
+
+    // chunks currently holding elements
+    [[nodiscard]] size_t chunks() const {
+        return chunk_count_;
+    }
+
+    [[nodiscard]] size_t pooled_chunks() const {
+        return pool_size_;
+    }
+
+    void clear() {
+        while (!empty()) {
+            pop_back();
+        }
+    }
+
+    // gives the pooled chunks back to the allocator
+    void shrink_to_fit() {
+        while (pool_ != nullptr) {
+            PoolNode* node = pool_;
+            pool_ = node->next;
+            alloc_.deallocate(reinterpret_cast<pointer>(node), kChunkSize);
+        }
+        pool_size_ = 0;
+    }
+
+    allocator_type get_allocator() const {
+        return alloc_;
+    }
+
+private:
+
+    static_assert(sizeof(T) * (size_t(1) << ChunkShift) >= sizeof(void*), "chunks are too small to be pooled");
+
+    static constexpr size_t kInitialChunkSlots = 4;
+
+    // pooled chunks keep the link in their own memory
+    struct PoolNode {
+        PoolNode* next;
+    };
+
+    [[nodiscard]] pointer chunkAt(size_t i) const {
+        return chunks_[(first_chunk_ + i) & (chunk_slots_ - 1)];
+    }
+
+    // pos counts from the start of the first chunk
+    [[nodiscard]] pointer slot(size_t pos) const {
+        return chunkAt(pos >> ChunkShift) + (pos & (kChunkSize - 1));
+    }
+
+    [[nodiscard]] reference element(size_t n) const {
+        return *std::launder(slot(head_ + n));
+    }
+
+    void twiceCapacity() {
+        if (full()) {
+            capacity_ = (capacity_ == 0) ? 1 : capacity_ * 2;
+        }
+    }
+
+    pointer takeChunk() {
+        if (pool_ == nullptr) {
+            return alloc_.allocate(kChunkSize);
+        }
+
+        PoolNode* node = pool_;
+        pool_ = node->next;
+        --pool_size_;
+
+        return reinterpret_cast<pointer>(node);
+    }
+
+    void poolChunk(pointer chunk) {
+        PoolNode* node = new (chunk) PoolNode{pool_};
+        pool_ = node;
+        ++pool_size_;
+    }
+
+    void appendChunk() {
+        growIndexIfFull();
+        chunks_[(first_chunk_ + chunk_count_) & (chunk_slots_ - 1)] = takeChunk();
+        ++chunk_count_;
+    }
+
+    void prependChunk() {
+        growIndexIfFull();
+        first_chunk_ = (first_chunk_ - 1) & (chunk_slots_ - 1);
+        chunks_[first_chunk_] = takeChunk();
+        ++chunk_count_;
+    }
+
+    void releaseFrontChunk() {
+        poolChunk(chunkAt(0));
+        first_chunk_ = (first_chunk_ + 1) & (chunk_slots_ - 1);
+        --chunk_count_;
+    }
+
+    void releaseBackChunk() {
+        poolChunk(chunkAt(chunk_count_ - 1));
+        --chunk_count_;
+    }
+
+    // only the chunk pointers move, never the elements
+    void growIndexIfFull() {
+        if (chunk_count_ < chunk_slots_) {
+            return;
+        }
+
+        pointer* old_chunks = chunks_;
+        size_t old_first = first_chunk_;
+        size_t old_slots = chunk_slots_;
+
+        allocateIndex(old_slots * 2);
+        for (size_t i = 0; i < chunk_count_; i++) {
+            chunks_[i] = old_chunks[(old_first + i) & (old_slots - 1)];
+        }
+        delete[] old_chunks;
+    }
+
+    void allocateIndex(size_t slots) {
+        chunks_ = new pointer[slots];
+        chunk_slots_ = slots;
+        first_chunk_ = 0;
+    }
+
+    pointer* chunks_ = nullptr;
+    size_t chunk_slots_ = 0;
+    size_t first_chunk_ = 0;
+    size_t chunk_count_ = 0;
+
+    size_t head_ = 0;
+    size_t size_ = 0;
+    size_t capacity_;
+
+    PoolNode* pool_ = nullptr;
+    size_t pool_size_ = 0;
+
+    Alloc alloc_;
+
+};
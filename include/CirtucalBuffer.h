@@ -1,16 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <functional>
 #include <initializer_list>
 #include <memory>
+#include <span>
 #include <stdexcept>
 #include "Iterator.h"
 #include "Allocator.h"
+#include "SegmentRange.h"
 
 #include <iostream>
 using namespace std;
 
 
-template<typename T, typename Alloc=CAllocator<T>>
+// buffers up to this many bytes of slots keep them inside the object instead of the heap
+constexpr size_t kCirtucalBufferInlineBytes = 64;
+
+template<typename T>
+constexpr size_t kDefaultInlineCapacity = (kCirtucalBufferInlineBytes / sizeof(T) > 1) ? kCirtucalBufferInlineBytes / sizeof(T) - 1 : 0;
+
+template<typename T, typename Alloc=CAllocator<T>, size_t InlineCapacity=kDefaultInlineCapacity<T>>
 class CCirtucalBuffer {
 public:
 
@@ -31,14 +42,14 @@ public:
         : capacity_(n + 1)
         , alloc_(Alloc())
     {
-        data_ = alloc_.allocate(capacity_);
+        allocateStorage(capacity_);
     }
 
     explicit CCirtucalBuffer(size_t n, const_reference val)
         : capacity_(n + 1)
         , alloc_(Alloc())
     {
-        data_ = alloc_.allocate(capacity_);
+        allocateStorage(capacity_);
         for (int i = 0; i < n; i++) {
             this->push_back(val);
         }
@@ -51,7 +62,7 @@ public:
         : capacity_(std::distance(first, last) + 1)
         , alloc_(Alloc())
     {
-        data_ = alloc_.allocate(capacity_);
+        allocateStorage(capacity_);
         std::copy(first, last, begin());
         write_pos_ = capacity_ - 1;
     }
@@ -60,7 +71,7 @@ public:
         : capacity_(il.size() + 1)
         , alloc_(Alloc())
     {
-        data_ = alloc_.allocate(capacity_);
+        allocateStorage(capacity_);
         for (const_reference i: il) {
             this->push_back(i);
         }
@@ -70,13 +81,12 @@ public:
         : capacity_(other.capacity_)
         , alloc_(Alloc())
     {
-        data_ = alloc_.allocate(capacity_);
-        std::copy(other.begin(), other.end(), begin());
-        write_pos_ = capacity_ - 1;
+        allocateStorage(capacity_);
+        copyFrom(other);
     }
 
     virtual ~CCirtucalBuffer() {
-        alloc_.deallocate(data_, capacity_);
+        deallocateStorage();
     }
 
     CCirtucalBuffer& operator=(const std::initializer_list<value_type>& il) {
@@ -84,21 +94,24 @@ public:
         return *this;
     }
 
+    // the current storage is kept whenever it is large enough
     CCirtucalBuffer& operator=(const CCirtucalBuffer& other) {
-        alloc_.deallocate(data_, capacity_);
-        capacity_ = other.capacity_;
-        data_ = alloc_.allocate(capacity_);
-
-        write_pos_ = other.write_pos_;
-        reader_pos_ = other.reader_pos_;
+        if (this == &other) {
+            return *this;
+        }
 
-        std::copy(other.begin(), other.end(), begin());
+        if (other.capacity_ > storage_size_) {
+            deallocateStorage();
+            allocateStorage(other.capacity_);
+        }
+        capacity_ = other.capacity_;
+        copyFrom(other);
 
         return *this;
     }
 
     bool operator==(const CCirtucalBuffer& other) const {
-        return size() == size() && std::equal(begin(), end(), other.begin());
+        return view() == other.view();
     }
 
     bool operator!=(const CCirtucalBuffer& other) const {
@@ -106,7 +119,16 @@ public:
     }
 
     void swap(CCirtucalBuffer& other) {
+        // inline storage can't change hands, its contents have to be copied
+        if (isInline() || other.isInline()) {
+            CCirtucalBuffer tmp(*this);
+            *this = other;
+            other = tmp;
+            return;
+        }
+
         std::swap(data_, other.data_);
+        std::swap(storage_size_, other.storage_size_);
         std::swap(capacity_, other.capacity_);
         std::swap(write_pos_, other.write_pos_);
         std::swap(reader_pos_, other.reader_pos_);
@@ -229,6 +251,50 @@ public:
         return operator[](n);
     }
 
+    // extra
+    // live elements as at most two contiguous pieces, in logical order
+    [[nodiscard]] CSegmentRange<value_type> segments() const {
+        if (write_pos_ >= reader_pos_) {
+            return {std::span(data_ + reader_pos_, write_pos_ - reader_pos_), std::span<value_type>()};
+        }
+
+        return {std::span(data_ + reader_pos_, capacity_ - reader_pos_), std::span(data_, write_pos_)};
+    }
+
+    // non-owning, invalidated like iterators by anything that moves the elements
+    [[nodiscard]] CCirtucalBufferView<value_type> view() const {
+        return segments();
+    }
+
+    // keyed lookup, elements have to be ordered by proj(element)
+    template<typename Key, typename Proj = std::identity>
+    [[nodiscard]] iterator lower_bound(const Key& key, Proj proj = {}) const {
+        return begin() + lowerBoundIndex(key, proj);
+    }
+
+    template<typename Key, typename Proj = std::identity>
+    [[nodiscard]] iterator upper_bound(const Key& key, Proj proj = {}) const {
+        return begin() + upperBoundIndex(key, proj);
+    }
+
+    // elements with from <= proj(element) <= to
+    template<typename Key, typename Proj = std::identity>
+    [[nodiscard]] CSegmentRange<value_type> range(const Key& from, const Key& to, Proj proj = {}) const {
+        size_t first = lowerBoundIndex(from, proj);
+        size_t last = std::max(first, upperBoundIndex(to, proj));
+
+        return segments().subrange(first, last);
+    }
+
+    // drops every element with proj(element) < key, returns how many were dropped
+    template<typename Key, typename Proj = std::identity>
+    size_t evict_older_than(const Key& key, Proj proj = {}) {
+        size_t n = lowerBoundIndex(key, proj);
+        reader_pos_ = (reader_pos_ + n) % capacity_;
+
+        return n;
+    }
+
     // extra
     template<typename... Args>
     void emplace_back(Args&&... args) {
@@ -317,11 +383,11 @@ public:
         size_t n = std::distance(first_, last_);
 
         clear();
-        if (n + 1 > capacity_) {
-            alloc_.deallocate(data_, capacity_);
-            capacity_ = n + 1;
-            data_ = alloc_.allocate(capacity_);
+        if (n + 1 > storage_size_) {
+            deallocateStorage();
+            allocateStorage(n + 1);
         }
+        capacity_ = std::max(capacity_, n + 1);
 
         first_--;
         while (++first_ != last_) {
@@ -466,32 +532,109 @@ protected:
         return pos;
     }
 
+    template<typename Key, typename Proj>
+    [[nodiscard]] size_t lowerBoundIndex(const Key& key, Proj& proj) const {
+        return partitionIndex([&](const_reference val) { return std::invoke(proj, val) < key; });
+    }
+
+    template<typename Key, typename Proj>
+    [[nodiscard]] size_t upperBoundIndex(const Key& key, Proj& proj) const {
+        return partitionIndex([&](const_reference val) { return !(key < std::invoke(proj, val)); });
+    }
+
+    // binary search over both pieces, the second one is only touched if the first is exhausted
+    template<typename Pred>
+    [[nodiscard]] size_t partitionIndex(Pred pred) const {
+        CSegmentRange<value_type> pieces = segments();
+        std::span<value_type> first = pieces.first();
+        std::span<value_type> second = pieces.second();
+
+        size_t n = std::ranges::partition_point(first, pred) - first.begin();
+        if (n < first.size()) {
+            return n;
+        }
+
+        return n + (std::ranges::partition_point(second, pred) - second.begin());
+    }
+
     void changeCapacityIfMore(size_t n, iterator& it) {
         if (n + 1 > capacity_) {
-            pointer new_data_ = alloc_.allocate(n + 1);
-            std::copy(begin(), end(), new_data_);
-
-            if (it != end()) {
-                it = Iterator(new_data_ + (it - begin()), new_data_, n + 1);
+            size_t offset = (std::addressof(*it) - data_ + capacity_ - reader_pos_) % capacity_;
+            size_t count = size();
+
+            if (n + 1 <= storage_size_) {
+                // enough room already, just unwrap the elements to the start of the storage
+                std::rotate(data_, data_ + reader_pos_, data_ + capacity_);
+            } else {
+                pointer old_data = data_;
+                size_t old_size = storage_size_;
+                CSegmentRange<value_type> pieces = segments();
+
+                allocateStorage(n + 1);
+                std::copy(pieces.second().begin(), pieces.second().end(),
+                          std::copy(pieces.first().begin(), pieces.first().end(), data_));
+                deallocateStorage(old_data, old_size);
             }
 
-            alloc_.deallocate(data_, capacity_);
-            data_ = new_data_;
-
-            write_pos_ = (write_pos_ < reader_pos_) ? capacity_ - (reader_pos_ - write_pos_) : write_pos_ - reader_pos_;
             capacity_ = n + 1;
             reader_pos_ = 0;
+            write_pos_ = count;
+            it = iterator(data_ + offset, data_, capacity_);
+        }
+    }
+
+    [[nodiscard]] pointer inlineData() const {
+        return reinterpret_cast<pointer>(const_cast<std::byte*>(inline_));
+    }
+
+    [[nodiscard]] bool isInline() const {
+        return kInlineSlots != 0 && data_ == inlineData();
+    }
+
+    // sets data_ to at least n slots, inside the object when they fit
+    void allocateStorage(size_t n) {
+        if (n <= kInlineSlots) {
+            data_ = inlineData();
+            storage_size_ = kInlineSlots;
+        } else {
+            data_ = alloc_.allocate(n);
+            storage_size_ = n;
         }
     }
 
+    void deallocateStorage() {
+        deallocateStorage(data_, storage_size_);
+    }
+
+    void deallocateStorage(pointer data, size_t n) {
+        if (kInlineSlots == 0 || data != inlineData()) {
+            alloc_.deallocate(data, n);
+        }
+    }
+
+    // other.capacity_ <= storage_size_, the elements are unwrapped to the start of the storage
+    void copyFrom(const CCirtucalBuffer& other) {
+        CSegmentRange<value_type> pieces = other.segments();
+        std::copy(pieces.second().begin(), pieces.second().end(),
+                  std::copy(pieces.first().begin(), pieces.first().end(), data_));
+
+        reader_pos_ = 0;
+        write_pos_ = pieces.size();
+    }
+
+    static constexpr size_t kInlineSlots = (InlineCapacity == 0) ? 0 : InlineCapacity + 1;
+
     size_t write_pos_ = 0;
     size_t reader_pos_ = 0;
 
     pointer data_;
     size_t capacity_;
+    size_t storage_size_ = 0;
 
     Alloc alloc_;
 
+    alignas(T) std::byte inline_[(kInlineSlots == 0) ? 1 : kInlineSlots * sizeof(T)];
+
 };
 
 
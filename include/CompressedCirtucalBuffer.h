@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+
+// ring of integers in a fixed byte budget: values are grouped into blocks, each
+// block keeps its first value as a base and the rest as zigzag varint deltas
+// from the previous value, so timestamps and slow counters take a byte or two.
+// a full ring evicts its oldest block as a whole
+template<typename T>
+class CCompressedCirtucalBuffer {
+    static_assert(std::is_integral_v<T>, "only integer types can be compressed");
+
+public:
+
+    using value_type = T;
+
+    class iterator {
+    public:
+        using value_type = T;
+        using reference = T;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::forward_iterator_tag;
+
+        iterator() = default;
+
+        [[nodiscard]] T operator*() const {
+            return value_;
+        }
+
+        // decodes one delta, or jumps to the base of the next block
+        iterator& operator++() {
+            ++index_;
+            if (++in_block_ < buffer_->blockAt(block_).count) {
+                value_ = buffer_->decodeNext(block_, offset_, value_);
+            } else if (index_ < buffer_->size_) {
+                ++block_;
+                in_block_ = 0;
+                offset_ = 0;
+                value_ = buffer_->blockAt(block_).base;
+            }
+
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator tmp(*this);
+            ++*this;
+
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator==(const iterator& other) const {
+            return index_ == other.index_;
+        }
+
+    private:
+        friend class CCompressedCirtucalBuffer;
+
+        iterator(const CCompressedCirtucalBuffer* buffer, size_t index)
+            : buffer_(buffer), index_(index)
+        {
+            if (index_ < buffer_->size_) {
+                value_ = buffer_->blockAt(0).base;
+            }
+        }
+
+        const CCompressedCirtucalBuffer* buffer_ = nullptr;
+        size_t index_ = 0;
+        size_t block_ = 0;
+        size_t in_block_ = 0;
+        size_t offset_ = 0;
+        T value_{};
+    };
+
+    using const_iterator = iterator;
+
+    // bytes is the payload budget, split into blocks of block_bytes each
+    explicit CCompressedCirtucalBuffer(size_t bytes, size_t block_bytes = 128)
+        : block_bytes_(block_bytes)
+        , block_capacity_(block_bytes == 0 ? 0 : bytes / block_bytes)
+    {
+        if (block_bytes_ < kMaxVarintBytes || block_capacity_ == 0) {
+            throw std::invalid_argument("budget too small for a block");
+        }
+
+        data_ = new uint8_t[block_capacity_ * block_bytes_];
+        blocks_ = new Block[block_capacity_];
+    }
+
+    CCompressedCirtucalBuffer(const CCompressedCirtucalBuffer&) = delete;
+    CCompressedCirtucalBuffer& operator=(const CCompressedCirtucalBuffer&) = delete;
+
+    ~CCompressedCirtucalBuffer() {
+        delete[] data_;
+        delete[] blocks_;
+    }
+
+    void push_back(T val) {
+        if (block_count_ != 0) {
+            Block& block = blockAt(block_count_ - 1);
+            uint64_t encoded = zigzag(val, last_);
+            if (block.used + varintLength(encoded) <= block_bytes_) {
+                block.used += encodeVarint(encoded, payload(block_count_ - 1) + block.used);
+                ++block.count;
+                ++size_;
+                ++next_seq_;
+                last_ = val;
+                return;
+            }
+        }
+
+        if (block_count_ == block_capacity_) {
+            pop_front_block();
+        }
+
+        ++block_count_;
+        blockAt(block_count_ - 1) = Block{val, next_seq_++, 1, 0};
+        ++size_;
+        last_ = val;
+    }
+
+    // drops the oldest block, returns how many values went with it
+    size_t pop_front_block() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        size_t count = blockAt(0).count;
+        first_block_ = (first_block_ + 1) % block_capacity_;
+        --block_count_;
+        size_ -= count;
+
+        return count;
+    }
+
+    // binary search over the block bases, then decodes within one block
+    [[nodiscard]] T operator[](size_t n) const {
+        if (n >= size_) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        uint64_t seq = blockAt(0).first_seq + n;
+        size_t lo = 0;
+        size_t hi = block_count_;
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (blockAt(mid).first_seq <= seq) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        T val = blockAt(lo).base;
+        size_t offset = 0;
+        for (uint64_t i = blockAt(lo).first_seq; i < seq; i++) {
+            val = decodeNext(lo, offset, val);
+        }
+
+        return val;
+    }
+
+    [[nodiscard]] T at(size_t n) const {
+        return operator[](n);
+    }
+
+    [[nodiscard]] T front() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return blockAt(0).base;
+    }
+
+    [[nodiscard]] T back() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return last_;
+    }
+
+    [[nodiscard]] iterator begin() const {
+        return iterator(this, 0);
+    }
+
+    [[nodiscard]] iterator end() const {
+        return iterator(this, size_);
+    }
+
+    [[nodiscard]] const_iterator cbegin() const {
+        return begin();
+    }
+
+    [[nodiscard]] const_iterator cend() const {
+        return end();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] size_t blocks() const {
+        return block_count_;
+    }
+
+    [[nodiscard]] size_t block_capacity() const {
+        return block_capacity_;
+    }
+
+    // encoded payload bytes currently in use
+    [[nodiscard]] size_t encoded_bytes() const {
+        size_t bytes = 0;
+        for (size_t i = 0; i < block_count_; i++) {
+            bytes += blockAt(i).used;
+        }
+
+        return bytes;
+    }
+
+    void clear() {
+        block_count_ = 0;
+        size_ = 0;
+    }
+
+private:
+
+    static constexpr size_t kMaxVarintBytes = 10;
+
+    using Unsigned = std::make_unsigned_t<T>;
+    using Signed = std::make_signed_t<T>;
+
+    struct Block {
+        T base;
+        uint64_t first_seq;
+        uint32_t count;
+        uint32_t used;
+    };
+
+    [[nodiscard]] Block& blockAt(size_t i) const {
+        return blocks_[(first_block_ + i) % block_capacity_];
+    }
+
+    [[nodiscard]] uint8_t* payload(size_t i) const {
+        return data_ + ((first_block_ + i) % block_capacity_) * block_bytes_;
+    }
+
+    // deltas wrap around like unsigned arithmetic, zigzag keeps small negative ones short
+    static uint64_t zigzag(T val, T prev) {
+        auto delta = static_cast<int64_t>(static_cast<Signed>(static_cast<Unsigned>(val) - static_cast<Unsigned>(prev)));
+        return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+    }
+
+    static T unzigzag(uint64_t encoded, T prev) {
+        auto delta = static_cast<int64_t>((encoded >> 1) ^ (~(encoded & 1) + 1));
+        return static_cast<T>(static_cast<Unsigned>(prev) + static_cast<Unsigned>(delta));
+    }
+
+    static size_t varintLength(uint64_t val) {
+        size_t n = 1;
+        while (val >= 0x80) {
+            val >>= 7;
+            ++n;
+        }
+
+        return n;
+    }
+
+    static size_t encodeVarint(uint64_t val, uint8_t* out) {
+        size_t n = 0;
+        while (val >= 0x80) {
+            out[n++] = static_cast<uint8_t>(val | 0x80);
+            val >>= 7;
+        }
+        out[n++] = static_cast<uint8_t>(val);
+
+        return n;
+    }
+
+    [[nodiscard]] T decodeNext(size_t block, size_t& offset, T prev) const {
+        const uint8_t* in = payload(block);
+        uint64_t val = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = in[offset++];
+            val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+
+        return unzigzag(val, prev);
+    }
+
+    uint8_t* data_;
+    Block* blocks_;
+    size_t block_bytes_;
+    size_t block_capacity_;
+
+    size_t first_block_ = 0;
+    size_t block_count_ = 0;
+    size_t size_ = 0;
+
+    uint64_t next_seq_ = 0;
+    T last_{};
+
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+
+// unbounded multi-producer single-consumer queue: instead of copying into a
+// twice larger buffer like CCirtucalBufferExt, a full ring segment gets a new
+// one linked behind it. producers never wait for growth.
+//
+// segments are never freed while the queue lives, only recycled, so a producer
+// can always touch the guard counter of a segment it read from tail_; the
+// consumer recycles a drained segment only after tail_ has moved past it and
+// no producer holds a guard on it
+template<typename T>
+class CConcurrentCirtucalBufferExt {
+public:
+
+    using value_type = T;
+    using const_reference = const T&;
+
+    explicit CConcurrentCirtucalBufferExt(size_t segment_capacity = 1024)
+        : capacity_(segment_capacity)
+    {
+        if (capacity_ == 0) {
+            throw std::invalid_argument("capacity must be positive");
+        }
+
+        head_ = newSegment();
+        tail_.store(head_);
+    }
+
+    CConcurrentCirtucalBufferExt(const CConcurrentCirtucalBufferExt&) = delete;
+    CConcurrentCirtucalBufferExt& operator=(const CConcurrentCirtucalBufferExt&) = delete;
+
+    ~CConcurrentCirtucalBufferExt() {
+        for (Segment* seg = head_; seg != nullptr; seg = seg->next.load()) {
+            for (size_t i = seg->deq; i < capacity_; i++) {
+                if (seg->slots[i].ready.load()) {
+                    seg->slots[i].value()->~T();
+                }
+            }
+        }
+
+        deleteChain(head_, [](Segment* seg) { return seg->next.load(); });
+        deleteChain(retired_, [](Segment* seg) { return seg->free_next; });
+        deleteChain(free_, [](Segment* seg) { return seg->free_next; });
+        deleteChain(returned_.load(), [](Segment* seg) { return seg->free_next; });
+        for (std::atomic<Segment*>& spare: spares_) {
+            delete spare.load();
+        }
+    }
+
+    // any thread, lock-free
+    void push_back(const_reference val) {
+        while (true) {
+            Segment* seg = acquireTail();
+
+            size_t i = seg->enq.fetch_add(1, std::memory_order_acq_rel);
+            if (i < capacity_) {
+                Slot& slot = seg->slots[i];
+                new (slot.storage) T(val);
+                slot.ready.store(true, std::memory_order_release);
+                seg->guards.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+
+            // segment is full, link a new one behind it or help whoever already did
+            Segment* next = seg->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                Segment* fresh = takeSegment();
+                if (seg->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel)) {
+                    next = fresh;
+                } else {
+                    giveBackSegment(fresh);
+                }
+            }
+
+            Segment* expected = seg;
+            tail_.compare_exchange_strong(expected, next, std::memory_order_acq_rel);
+            seg->guards.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // consumer thread only; false if there is nothing to take yet
+    bool try_pop_front(T& out) {
+        while (true) {
+            Segment* seg = head_;
+            if (seg->deq < capacity_) {
+                Slot& slot = seg->slots[seg->deq];
+                if (!slot.ready.load(std::memory_order_acquire)) {
+                    return false;
+                }
+
+                T* val = slot.value();
+                out = *val;
+                val->~T();
+                slot.ready.store(false, std::memory_order_relaxed);
+                ++seg->deq;
+                return true;
+            }
+
+            Segment* next = seg->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+
+            head_ = next;
+            retire(seg);
+        }
+    }
+
+    // consumer thread only
+    [[nodiscard]] bool empty() const {
+        Segment* seg = head_;
+        if (seg->deq < capacity_) {
+            return !seg->slots[seg->deq].ready.load(std::memory_order_acquire);
+        }
+
+        return seg->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    [[nodiscard]] size_t segment_capacity() const {
+        return capacity_;
+    }
+
+    // segments ever allocated, recycled ones are not counted again
+    [[nodiscard]] size_t segments_allocated() const {
+        return allocated_.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    struct Slot {
+        std::atomic<bool> ready{false};
+        alignas(T) std::byte storage[sizeof(T)];
+
+        T* value() {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    struct Segment {
+        explicit Segment(size_t n)
+            : slots(new Slot[n])
+        {}
+
+        ~Segment() {
+            delete[] slots;
+        }
+
+        alignas(64) std::atomic<size_t> enq{0};
+        alignas(64) std::atomic<size_t> guards{0};
+        std::atomic<Segment*> next{nullptr};
+
+        // consumer side
+        alignas(64) size_t deq = 0;
+        Segment* free_next = nullptr;
+
+        Slot* slots;
+    };
+
+    // guard first, then make sure the segment is still the tail
+    Segment* acquireTail() {
+        while (true) {
+            Segment* seg = tail_.load(std::memory_order_acquire);
+            seg->guards.fetch_add(1, std::memory_order_seq_cst);
+            if (tail_.load(std::memory_order_seq_cst) == seg) {
+                return seg;
+            }
+            seg->guards.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    Segment* newSegment() {
+        allocated_.fetch_add(1, std::memory_order_relaxed);
+        return new Segment(capacity_);
+    }
+
+    // producers take one of the spares the consumer keeps ready, or allocate
+    Segment* takeSegment() {
+        for (std::atomic<Segment*>& spare: spares_) {
+            if (spare.load(std::memory_order_relaxed) != nullptr) {
+                Segment* seg = spare.exchange(nullptr, std::memory_order_acq_rel);
+                if (seg != nullptr) {
+                    return seg;
+                }
+            }
+        }
+
+        return newSegment();
+    }
+
+    // a segment that lost the linking race; pushed only, drained by the consumer at once, so no ABA
+    void giveBackSegment(Segment* seg) {
+        Segment* top = returned_.load(std::memory_order_relaxed);
+        do {
+            seg->free_next = top;
+        } while (!returned_.compare_exchange_weak(top, seg, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void retire(Segment* seg) {
+        seg->free_next = retired_;
+        retired_ = seg;
+        reclaim();
+    }
+
+    void reclaim() {
+        Segment** link = &retired_;
+        while (*link != nullptr) {
+            Segment* seg = *link;
+            if (tail_.load(std::memory_order_seq_cst) != seg && seg->guards.load(std::memory_order_seq_cst) == 0) {
+                *link = seg->free_next;
+                reset(seg);
+                seg->free_next = free_;
+                free_ = seg;
+            } else {
+                link = &seg->free_next;
+            }
+        }
+
+        Segment* returned = returned_.exchange(nullptr, std::memory_order_acquire);
+        while (returned != nullptr) {
+            Segment* seg = returned;
+            returned = returned->free_next;
+            seg->free_next = free_;
+            free_ = seg;
+        }
+
+        // only the consumer fills the spares, so an empty one stays empty until it does
+        for (std::atomic<Segment*>& spare: spares_) {
+            if (free_ == nullptr) {
+                break;
+            }
+
+            if (spare.load(std::memory_order_relaxed) == nullptr) {
+                Segment* seg = free_;
+                free_ = seg->free_next;
+                spare.store(seg, std::memory_order_release);
+            }
+        }
+    }
+
+    // the guard counter is left alone, late producers still balance their own increments
+    void reset(Segment* seg) {
+        seg->enq.store(0, std::memory_order_relaxed);
+        seg->next.store(nullptr, std::memory_order_relaxed);
+        seg->deq = 0;
+    }
+
+    template<typename Next>
+    static void deleteChain(Segment* seg, Next next) {
+        while (seg != nullptr) {
+            Segment* following = next(seg);
+            delete seg;
+            seg = following;
+        }
+    }
+
+    alignas(64) std::atomic<Segment*> tail_{nullptr};
+    static constexpr size_t kSpares = 8;
+
+    alignas(64) std::atomic<Segment*> spares_[kSpares] = {};
+    alignas(64) std::atomic<Segment*> returned_{nullptr};
+    std::atomic<size_t> allocated_{0};
+
+    // consumer side
+    alignas(64) Segment* head_;
+    Segment* retired_ = nullptr;
+    Segment* free_ = nullptr;
+
+    size_t capacity_;
+
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "Iterator.h"
+#include "Allocator.h"
+
+
+// ring paired with an open-addressing hash index over its slots, so "seen in
+// the last N" is O(1); the index follows every eviction and never allocates.
+// elements are read-only once pushed, changing a key in place would desync the index
+template<typename T, typename KeyOf=std::identity,
+         typename Hash=std::hash<std::remove_cvref_t<std::invoke_result_t<KeyOf, const T&>>>>
+class CKeyedCirtucalBuffer {
+public:
+
+    using value_type = T;
+    using pointer = T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using key_type = std::remove_cvref_t<std::invoke_result_t<KeyOf, const T&>>;
+    using const_iterator = Iterator<const T>;
+    using iterator = const_iterator;
+
+    explicit CKeyedCirtucalBuffer(size_t n, KeyOf key_of = {}, Hash hash = {})
+        : capacity_(n + 1)
+        , index_size_(std::bit_ceil(2 * capacity_))
+        , key_of_(key_of)
+        , hash_(hash)
+    {
+        allocate();
+    }
+
+    CKeyedCirtucalBuffer(const CKeyedCirtucalBuffer& other)
+        : capacity_(other.capacity_)
+        , index_size_(other.index_size_)
+        , key_of_(other.key_of_)
+        , hash_(other.hash_)
+    {
+        allocate();
+        std::copy(other.data_, other.data_ + capacity_, data_);
+        std::copy(other.index_, other.index_ + index_size_, index_);
+        write_pos_ = other.write_pos_;
+        reader_pos_ = other.reader_pos_;
+    }
+
+    ~CKeyedCirtucalBuffer() {
+        deallocate();
+    }
+
+    CKeyedCirtucalBuffer& operator=(const CKeyedCirtucalBuffer& other) {
+        if (this != &other) {
+            CKeyedCirtucalBuffer tmp(other);
+            swap(tmp);
+        }
+
+        return *this;
+    }
+
+    void swap(CKeyedCirtucalBuffer& other) {
+        std::swap(data_, other.data_);
+        std::swap(index_, other.index_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(index_size_, other.index_size_);
+        std::swap(write_pos_, other.write_pos_);
+        std::swap(reader_pos_, other.reader_pos_);
+        std::swap(key_of_, other.key_of_);
+        std::swap(hash_, other.hash_);
+    }
+
+    // the oldest element is evicted from the ring and from the index when full
+    void push_back(const_reference val) {
+        if (full()) {
+            pop_front();
+        }
+
+        data_[write_pos_] = val;
+        insertIndex(write_pos_);
+        write_pos_ = getIncrement(write_pos_);
+    }
+
+    // dedup helper, false and no insertion if the key is already in the window
+    bool push_back_unique(const_reference val) {
+        if (contains(std::invoke(key_of_, val))) {
+            return false;
+        }
+
+        push_back(val);
+        return true;
+    }
+
+    void pop_front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        eraseIndex(reader_pos_);
+        reader_pos_ = getIncrement(reader_pos_);
+    }
+
+    [[nodiscard]] bool contains(const key_type& key) const {
+        return findSlot(key) != kEmpty;
+    }
+
+    // one of the elements with this key, end() if there is none
+    [[nodiscard]] const_iterator find(const key_type& key) const {
+        size_t slot = findSlot(key);
+        return (slot == kEmpty) ? end() : const_iterator(data_ + slot, data_, capacity_);
+    }
+
+    [[nodiscard]] const_reference front() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return data_[reader_pos_];
+    }
+
+    [[nodiscard]] const_reference back() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return data_[getDecrement(write_pos_)];
+    }
+
+    [[nodiscard]] const_reference operator[](size_t n) const {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return data_[(reader_pos_ + n) % capacity_];
+    }
+
+    [[nodiscard]] const_reference at(size_t n) const {
+        return operator[](n);
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return const_iterator(data_ + reader_pos_, data_, capacity_);
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return const_iterator(data_ + write_pos_, data_, capacity_);
+    }
+
+    [[nodiscard]] bool empty() const {
+        return write_pos_ == reader_pos_;
+    }
+
+    [[nodiscard]] bool full() const {
+        return write_pos_ == getDecrement(reader_pos_);
+    }
+
+    void clear() {
+        std::fill(index_, index_ + index_size_, Entry{kEmpty, 0});
+        write_pos_ = 0;
+        reader_pos_ = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        if (write_pos_ >= reader_pos_) {
+            return write_pos_ - reader_pos_;
+        } else {
+            return capacity_ - (reader_pos_ - write_pos_);
+        }
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_ - 1;
+    }
+
+private:
+
+    static constexpr size_t kEmpty = static_cast<size_t>(-1);
+
+    struct Entry {
+        size_t slot;
+        size_t hash;
+    };
+
+    [[nodiscard]] size_t getIncrement(size_t pos) const {
+        return (pos + 1) % capacity_;
+    }
+
+    [[nodiscard]] size_t getDecrement(size_t pos) const {
+        return (pos == 0) ? (capacity_ - 1) : (pos - 1);
+    }
+
+    [[nodiscard]] size_t mask() const {
+        return index_size_ - 1;
+    }
+
+    void insertIndex(size_t slot) {
+        size_t hash = hash_(std::invoke(key_of_, data_[slot]));
+        size_t pos = hash & mask();
+        while (index_[pos].slot != kEmpty) {
+            pos = (pos + 1) & mask();
+        }
+
+        index_[pos] = Entry{slot, hash};
+    }
+
+    // linear probing with backward shift, so no tombstones pile up
+    void eraseIndex(size_t slot) {
+        size_t pos = hash_(std::invoke(key_of_, data_[slot])) & mask();
+        while (index_[pos].slot != slot) {
+            pos = (pos + 1) & mask();
+        }
+
+        size_t next = pos;
+        while (true) {
+            next = (next + 1) & mask();
+            if (index_[next].slot == kEmpty) {
+                break;
+            }
+
+            size_t home = index_[next].hash & mask();
+            bool movable = (next > pos) ? (home <= pos || home > next) : (home <= pos && home > next);
+            if (movable) {
+                index_[pos] = index_[next];
+                pos = next;
+            }
+        }
+
+        index_[pos].slot = kEmpty;
+    }
+
+    [[nodiscard]] size_t findSlot(const key_type& key) const {
+        size_t hash = hash_(key);
+        for (size_t pos = hash & mask(); index_[pos].slot != kEmpty; pos = (pos + 1) & mask()) {
+            if (index_[pos].hash == hash && std::invoke(key_of_, data_[index_[pos].slot]) == key) {
+                return index_[pos].slot;
+            }
+        }
+
+        return kEmpty;
+    }
+
+    void allocate() {
+        data_ = CAllocator<T>().allocate(capacity_);
+        std::uninitialized_value_construct_n(data_, capacity_);
+
+        index_ = CAllocator<Entry>().allocate(index_size_);
+        std::uninitialized_fill_n(index_, index_size_, Entry{kEmpty, 0});
+    }
+
+    void deallocate() {
+        std::destroy_n(data_, capacity_);
+        CAllocator<T>().deallocate(data_, capacity_);
+        CAllocator<Entry>().deallocate(index_, index_size_);
+    }
+
+    size_t write_pos_ = 0;
+    size_t reader_pos_ = 0;
+
+    pointer data_;
+    size_t capacity_;
+
+    Entry* index_;
+    size_t index_size_;
+
+    KeyOf key_of_;
+    Hash hash_;
+
+};
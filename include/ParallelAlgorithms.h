@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include "SegmentRange.h"
+
+
+// parallel algorithms over anything with segments(), e.g. CCirtucalBuffer;
+// work is split by logical index into cache-sized chunks, so every chunk
+// is at most two contiguous pieces and the wrap point never matters
+
+constexpr size_t kParallelChunkBytes = 64 * 1024;
+
+inline size_t parallel_thread_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+template<typename T>
+constexpr size_t parallelChunkSize() {
+    return std::max<size_t>(1, kParallelChunkBytes / sizeof(T));
+}
+
+// persistent workers shared by every parallel algorithm. a call hands one job to
+// the requested number of workers, runs it on the calling thread too and waits;
+// calls from inside a job run inline, concurrent callers take turns
+class CParallelPool {
+public:
+
+    explicit CParallelPool(size_t workers)
+        : workers_(workers)
+        , threads_(new std::thread[workers])
+    {
+        for (size_t i = 0; i < workers_; i++) {
+            threads_[i] = std::thread([this]() { loop(); });
+        }
+    }
+
+    CParallelPool(const CParallelPool&) = delete;
+    CParallelPool& operator=(const CParallelPool&) = delete;
+
+    ~CParallelPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+
+        for (size_t i = 0; i < workers_; i++) {
+            threads_[i].join();
+        }
+    }
+
+    // job must not throw, helpers is capped by the pool size
+    template<typename Job>
+    void run(size_t helpers, Job& job) {
+        helpers = std::min(helpers, workers_);
+        if (helpers == 0 || inWorker()) {
+            job();
+            return;
+        }
+
+        std::lock_guard<std::mutex> turn(dispatch_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job_ = [](void* arg) { (*static_cast<Job*>(arg))(); };
+            job_arg_ = &job;
+            wanted_ = helpers;
+            pending_ = helpers;
+            ++generation_;
+        }
+        wake_.notify_all();
+
+        inWorker() = true;
+        job();
+        inWorker() = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+    }
+
+private:
+
+    // set on pool threads and on a caller while it runs its share of a job
+    static bool& inWorker() {
+        thread_local bool in_worker = false;
+        return in_worker;
+    }
+
+    void loop() {
+        inWorker() = true;
+
+        uint64_t seen = 0;
+        while (true) {
+            void (*job)(void*);
+            void* arg;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || (generation_ != seen && wanted_ != 0); });
+                if (stop_) {
+                    return;
+                }
+
+                seen = generation_;
+                --wanted_;
+                job = job_;
+                arg = job_arg_;
+            }
+
+            job(arg);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    size_t workers_;
+    std::unique_ptr<std::thread[]> threads_;
+
+    std::mutex dispatch_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    void (*job_)(void*) = nullptr;
+    void* job_arg_ = nullptr;
+    size_t wanted_ = 0;
+    size_t pending_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+inline CParallelPool& parallelPool() {
+    static CParallelPool pool(parallel_thread_count() - 1);
+    return pool;
+}
+
+// calls fn(chunk, from, to) for every chunk, chunks are handed out to the workers one at a time;
+// the first exception stops the hand-out and is rethrown on the calling thread
+template<typename Fn>
+void parallelChunks(size_t n, size_t chunk, Fn fn) {
+    size_t chunks = (n + chunk - 1) / chunk;
+    if (chunks == 0) {
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    auto work = [&]() {
+        try {
+            for (size_t i = next++; i < chunks; i = next++) {
+                fn(i, i * chunk, std::min(n, (i + 1) * chunk));
+            }
+        } catch (...) {
+            if (!failed.exchange(true)) {
+                error = std::current_exception();
+            }
+            next = chunks;
+        }
+    };
+
+    parallelPool().run(std::min(parallel_thread_count(), chunks) - 1, work);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template<typename T, typename Fn>
+void forEachPiece(const CSegmentRange<T>& range, Fn fn) {
+    if (!range.first().empty()) {
+        fn(range.first());
+    }
+    if (!range.second().empty()) {
+        fn(range.second());
+    }
+}
+
+template<typename Buffer, typename Fn>
+void parallel_for_each(const Buffer& buffer, Fn fn) {
+    auto range = buffer.segments();
+    using T = typename decltype(range)::value_type;
+
+    parallelChunks(range.size(), parallelChunkSize<T>(), [&](size_t, size_t from, size_t to) {
+        forEachPiece(range.subrange(from, to), [&](auto piece) {
+            std::for_each(piece.begin(), piece.end(), fn);
+        });
+    });
+}
+
+// out[i] = fn(buffer[i]) for the logical index i
+template<typename Buffer, typename OutIterator, typename Fn>
+OutIterator parallel_transform(const Buffer& buffer, OutIterator out, Fn fn) {
+    auto range = buffer.segments();
+    using T = typename decltype(range)::value_type;
+
+    parallelChunks(range.size(), parallelChunkSize<T>(), [&](size_t, size_t from, size_t to) {
+        OutIterator cur = out + from;
+        forEachPiece(range.subrange(from, to), [&](auto piece) {
+            cur = std::transform(piece.begin(), piece.end(), cur, fn);
+        });
+    });
+
+    return out + range.size();
+}
+
+// op has to be associative, partial results are folded in logical order
+template<typename Buffer, typename Result, typename Op = std::plus<>>
+Result parallel_reduce(const Buffer& buffer, Result init, Op op = {}) {
+    auto range = buffer.segments();
+    using T = typename decltype(range)::value_type;
+
+    size_t chunk = parallelChunkSize<T>();
+    size_t chunks = (range.size() + chunk - 1) / chunk;
+    std::unique_ptr<std::optional<Result>[]> partial(new std::optional<Result>[chunks]);
+
+    // every chunk is folded over its one or two contiguous pieces
+    parallelChunks(range.size(), chunk, [&](size_t i, size_t from, size_t to) {
+        forEachPiece(range.subrange(from, to), [&](auto piece) {
+            if (partial[i]) {
+                partial[i] = std::accumulate(piece.begin(), piece.end(), std::move(*partial[i]), op);
+            } else {
+                partial[i].emplace(std::accumulate(piece.begin() + 1, piece.end(), Result(piece[0]), op));
+            }
+        });
+    });
+
+    for (size_t i = 0; i < chunks; i++) {
+        init = op(std::move(init), std::move(*partial[i]));
+    }
+
+    return init;
+}
+
+// sorted copy of the buffer into [out, out + size()), the buffer itself is left untouched
+template<typename Buffer, typename OutIterator, typename Compare = std::less<>>
+OutIterator parallel_sort_copy(const Buffer& buffer, OutIterator out, Compare comp = {}) {
+    auto range = buffer.segments();
+    using T = typename decltype(range)::value_type;
+
+    size_t n = range.size();
+    size_t run = parallelChunkSize<T>();
+
+    parallelChunks(n, run, [&](size_t, size_t from, size_t to) {
+        OutIterator cur = out + from;
+        forEachPiece(range.subrange(from, to), [&](auto piece) {
+            cur = std::copy(piece.begin(), piece.end(), cur);
+        });
+        std::sort(out + from, out + to, comp);
+    });
+
+    // pairwise merge of the sorted runs, every round halves their number
+    for (size_t width = run; width < n; width *= 2) {
+        parallelChunks(n, 2 * width, [&](size_t, size_t from, size_t to) {
+            if (from + width < to) {
+                std::inplace_merge(out + from, out + from + width, out + to, comp);
+            }
+        });
+    }
+
+    return out + n;
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "BroadcastCirtucalBuffer.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+struct CStageMetrics {
+    size_t processed;
+    size_t queue_depth;
+    double throughput;  // items per second since start()
+};
+
+
+// bounded single-producer single-consumer hand-off between two stages,
+// a broadcast ring with exactly one reader
+template<typename T>
+class CPipelineLink {
+public:
+
+    explicit CPipelineLink(size_t capacity)
+        : ring_(capacity, 1)
+        , reader_(ring_.register_reader())
+    {}
+
+    // publishes the whole batch, waiting while the ring is full
+    void push(std::span<const T> batch) {
+        size_t done = 0;
+        while (done < batch.size()) {
+            size_t written = ring_.try_push_back(batch.begin() + done, batch.end());
+            if (written == 0) {
+                std::this_thread::yield();
+            }
+            done += written;
+        }
+    }
+
+    void push(const T& val) {
+        ring_.push_back(val);
+    }
+
+    [[nodiscard]] bool try_push(const T& val) {
+        return ring_.try_push_back(val);
+    }
+
+    [[nodiscard]] CSegmentRange<const T> claim() {
+        return ring_.claim(reader_);
+    }
+
+    void release(size_t n) {
+        ring_.release(reader_, n);
+    }
+
+    [[nodiscard]] size_t depth() const {
+        return ring_.available(reader_);
+    }
+
+    void close() {
+        closed_.store(true, std::memory_order_release);
+    }
+
+    // true once the writer closed the link and everything was consumed
+    [[nodiscard]] bool drained() const {
+        return closed_.load(std::memory_order_acquire) && depth() == 0;
+    }
+
+private:
+    CBroadcastCirtucalBuffer<T> ring_;
+    typename CBroadcastCirtucalBuffer<T>::reader_id reader_;
+    std::atomic<bool> closed_{false};
+};
+
+
+class CPipelineStage {
+public:
+
+    explicit CPipelineStage(int core)
+        : core_(core)
+    {}
+
+    virtual ~CPipelineStage() = default;
+
+    void start() {
+        thread_ = std::thread([this]() {
+            pin();
+            run();
+        });
+    }
+
+    void join() {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    [[nodiscard]] CStageMetrics metrics(double seconds) const {
+        size_t processed = processed_.load(std::memory_order_relaxed);
+        return {processed, queueDepth(), (seconds > 0) ? static_cast<double>(processed) / seconds : 0.0};
+    }
+
+    std::unique_ptr<CPipelineStage> next;
+
+protected:
+
+    virtual void run() = 0;
+    [[nodiscard]] virtual size_t queueDepth() const = 0;
+
+    // drains the input link in batches until it is closed and empty
+    template<typename In, typename Fn>
+    void consume(CPipelineLink<In>& input, Fn on_item) {
+        while (true) {
+            CSegmentRange<const In> items = input.claim();
+            if (items.empty()) {
+                if (input.drained()) {
+                    return;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            for (const In& item: items) {
+                on_item(item);
+            }
+            input.release(items.size());
+            processed_.fetch_add(items.size(), std::memory_order_relaxed);
+        }
+    }
+
+private:
+
+    void pin() {
+#ifdef __linux__
+        if (core_ >= 0 && core_ < CPU_SETSIZE) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core_, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#endif
+    }
+
+    std::thread thread_;
+    int core_;
+    std::atomic<size_t> processed_{0};
+};
+
+
+template<typename In, typename Out, typename Fn>
+class CTransformStage : public CPipelineStage {
+public:
+
+    CTransformStage(CPipelineLink<In>* input, size_t capacity, size_t batch, Fn fn, int core)
+        : CPipelineStage(core)
+        , input_(input)
+        , output_(new CPipelineLink<Out>(capacity))
+        , batch_(batch)
+        , fn_(std::move(fn))
+    {}
+
+    [[nodiscard]] CPipelineLink<Out>* output() const {
+        return output_.get();
+    }
+
+protected:
+
+    // results are collected into a local batch and handed on a batch at a time;
+    // the vector constructs every result, so Out needn't be trivially copyable
+    void run() override {
+        std::vector<Out> batch;
+        batch.reserve(batch_);
+
+        consume(*input_, [&](const In& item) {
+            batch.push_back(fn_(item));
+            if (batch.size() == batch_) {
+                flush(batch);
+            }
+        });
+        flush(batch);
+
+        output_->close();
+    }
+
+    [[nodiscard]] size_t queueDepth() const override {
+        return input_->depth();
+    }
+
+private:
+
+    void flush(std::vector<Out>& batch) {
+        output_->push(std::span<const Out>(batch));
+        batch.clear();
+    }
+
+    CPipelineLink<In>* input_;
+    std::unique_ptr<CPipelineLink<Out>> output_;
+    size_t batch_;
+    Fn fn_;
+};
+
+
+template<typename In, typename Fn>
+class CSinkStage : public CPipelineStage {
+public:
+
+    CSinkStage(CPipelineLink<In>* input, Fn fn, int core)
+        : CPipelineStage(core)
+        , input_(input)
+        , fn_(std::move(fn))
+    {}
+
+protected:
+
+    void run() override {
+        consume(*input_, fn_);
+    }
+
+    [[nodiscard]] size_t queueDepth() const override {
+        return input_->depth();
+    }
+
+private:
+    CPipelineLink<In>* input_;
+    Fn fn_;
+};
+
+
+// source -> stage -> ... -> sink, every stage on its own (optionally pinned) thread,
+// consecutive stages connected by bounded rings that push back when full
+template<typename In>
+class CPipeline {
+public:
+
+    CPipeline(std::unique_ptr<CPipelineLink<In>> input, std::unique_ptr<CPipelineStage> stages)
+        : input_(std::move(input))
+        , stages_(std::move(stages))
+    {}
+
+    CPipeline(CPipeline&&) = default;
+
+    ~CPipeline() {
+        if (started_ && input_) {
+            close();
+            wait();
+        }
+    }
+
+    void start() {
+        if (started_) {
+            return;
+        }
+
+        started_ = true;
+        started_at_ = std::chrono::steady_clock::now();
+        for (CPipelineStage* stage = stages_.get(); stage != nullptr; stage = stage->next.get()) {
+            stage->start();
+        }
+    }
+
+    // blocks while the first ring is full
+    void push(const In& val) {
+        input_->push(val);
+    }
+
+    void push(std::span<const In> batch) {
+        input_->push(batch);
+    }
+
+    // false instead of blocking when the first ring is full
+    [[nodiscard]] bool try_push(const In& val) {
+        return input_->try_push(val);
+    }
+
+    // no more input, the stages finish what is queued and stop
+    void close() {
+        input_->close();
+    }
+
+    void wait() {
+        for (CPipelineStage* stage = stages_.get(); stage != nullptr; stage = stage->next.get()) {
+            stage->join();
+        }
+    }
+
+    [[nodiscard]] size_t stages() const {
+        size_t n = 0;
+        for (CPipelineStage* stage = stages_.get(); stage != nullptr; stage = stage->next.get()) {
+            ++n;
+        }
+
+        return n;
+    }
+
+    [[nodiscard]] CStageMetrics stage_metrics(size_t i) const {
+        CPipelineStage* stage = stages_.get();
+        for (; stage != nullptr && i != 0; --i) {
+            stage = stage->next.get();
+        }
+
+        if (stage == nullptr) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started_at_;
+        return stage->metrics(started_ ? elapsed.count() : 0.0);
+    }
+
+private:
+    std::unique_ptr<CPipelineLink<In>> input_;
+    std::unique_ptr<CPipelineStage> stages_;
+
+    bool started_ = false;
+    std::chrono::steady_clock::time_point started_at_;
+};
+
+
+template<typename In, typename Cur>
+class CPipelineBuilder {
+public:
+
+    CPipelineBuilder(std::unique_ptr<CPipelineLink<In>> input, std::unique_ptr<CPipelineStage> first,
+                     CPipelineStage* last, CPipelineLink<Cur>* tail, size_t capacity, size_t batch)
+        : input_(std::move(input))
+        , first_(std::move(first))
+        , last_(last)
+        , tail_(tail)
+        , capacity_(capacity)
+        , batch_(batch)
+    {}
+
+    // core < 0 leaves the stage thread unpinned
+    template<typename Fn>
+    auto stage(Fn fn, int core = -1) && {
+        using Out = std::remove_cvref_t<std::invoke_result_t<Fn&, const Cur&>>;
+
+        auto* stage = new CTransformStage<Cur, Out, Fn>(tail_, capacity_, batch_, std::move(fn), core);
+        CPipelineLink<Out>* output = stage->output();
+        append(stage);
+
+        return CPipelineBuilder<In, Out>(std::move(input_), std::move(first_), last_, output, capacity_, batch_);
+    }
+
+    template<typename Fn>
+    CPipeline<In> sink(Fn fn, int core = -1) && {
+        append(new CSinkStage<Cur, Fn>(tail_, std::move(fn), core));
+        return CPipeline<In>(std::move(input_), std::move(first_));
+    }
+
+private:
+
+    void append(CPipelineStage* stage) {
+        if (last_ == nullptr) {
+            first_.reset(stage);
+        } else {
+            last_->next.reset(stage);
+        }
+        last_ = stage;
+    }
+
+    std::unique_ptr<CPipelineLink<In>> input_;
+    std::unique_ptr<CPipelineStage> first_;
+    CPipelineStage* last_;
+    CPipelineLink<Cur>* tail_;
+    size_t capacity_;
+    size_t batch_;
+};
+
+
+// capacity of every ring between two stages, batch is how many results a stage hands on at once
+template<typename In>
+CPipelineBuilder<In, In> make_pipeline(size_t capacity = 1024, size_t batch = 64) {
+    if (capacity == 0 || batch == 0) {
+        throw std::invalid_argument("pipeline capacity and batch must be positive");
+    }
+
+    auto input = std::make_unique<CPipelineLink<In>>(capacity);
+    CPipelineLink<In>* tail = input.get();
+
+    return CPipelineBuilder<In, In>(std::move(input), nullptr, nullptr, tail, capacity, batch);
+}
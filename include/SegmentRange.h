@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+
+// index-based iterator over a container with operator[], never confused by the wrap point
+template<typename Range, typename T>
+class SegmentIterator {
+public:
+    using value_type = std::remove_cv_t<T>;
+    using pointer = T*;
+    using reference = T&;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    SegmentIterator() = default;
+
+    explicit SegmentIterator(const Range* range, size_t index)
+        : range_(range), index_(index) {}
+
+    [[nodiscard]] reference operator*() const {
+        return (*range_)[index_];
+    }
+
+    [[nodiscard]] pointer operator->() const {
+        return &(*range_)[index_];
+    }
+
+    [[nodiscard]] reference operator[](difference_type n) const {
+        return (*range_)[index_ + n];
+    }
+
+    SegmentIterator& operator++() {
+        ++index_;
+        return *this;
+    }
+
+    SegmentIterator& operator--() {
+        --index_;
+        return *this;
+    }
+
+    SegmentIterator operator++(int) {
+        SegmentIterator tmp(*this);
+        ++index_;
+
+        return tmp;
+    }
+
+    SegmentIterator operator--(int) {
+        SegmentIterator tmp(*this);
+        --index_;
+
+        return tmp;
+    }
+
+    SegmentIterator& operator+=(difference_type n) {
+        index_ += n;
+        return *this;
+    }
+
+    SegmentIterator& operator-=(difference_type n) {
+        index_ -= n;
+        return *this;
+    }
+
+    [[nodiscard]] SegmentIterator operator+(difference_type n) const {
+        return SegmentIterator(range_, index_ + n);
+    }
+
+    friend SegmentIterator operator+(difference_type n, const SegmentIterator& it) {
+        return it + n;
+    }
+
+    [[nodiscard]] SegmentIterator operator-(difference_type n) const {
+        return SegmentIterator(range_, index_ - n);
+    }
+
+    [[nodiscard]] difference_type operator-(const SegmentIterator& other) const {
+        return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+
+    [[nodiscard]] bool operator==(const SegmentIterator& other) const {
+        return index_ == other.index_;
+    }
+
+    [[nodiscard]] auto operator<=>(const SegmentIterator& other) const {
+        return index_ <=> other.index_;
+    }
+
+private:
+    const Range* range_ = nullptr;
+    size_t index_ = 0;
+};
+
+
+// iterator over two pieces that carries the pieces itself, so it outlives the range it came from
+template<typename T>
+class SegmentSpanIterator {
+public:
+    using value_type = std::remove_cv_t<T>;
+    using pointer = T*;
+    using reference = T&;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    SegmentSpanIterator() = default;
+
+    explicit SegmentSpanIterator(std::span<T> first, std::span<T> second, size_t index)
+        : first_(first), second_(second), index_(index) {}
+
+    [[nodiscard]] reference operator*() const {
+        return element(index_);
+    }
+
+    [[nodiscard]] pointer operator->() const {
+        return &element(index_);
+    }
+
+    [[nodiscard]] reference operator[](difference_type n) const {
+        return element(index_ + n);
+    }
+
+    SegmentSpanIterator& operator++() {
+        ++index_;
+        return *this;
+    }
+
+    SegmentSpanIterator& operator--() {
+        --index_;
+        return *this;
+    }
+
+    SegmentSpanIterator operator++(int) {
+        SegmentSpanIterator tmp(*this);
+        ++index_;
+
+        return tmp;
+    }
+
+    SegmentSpanIterator operator--(int) {
+        SegmentSpanIterator tmp(*this);
+        --index_;
+
+        return tmp;
+    }
+
+    SegmentSpanIterator& operator+=(difference_type n) {
+        index_ += n;
+        return *this;
+    }
+
+    SegmentSpanIterator& operator-=(difference_type n) {
+        index_ -= n;
+        return *this;
+    }
+
+    [[nodiscard]] SegmentSpanIterator operator+(difference_type n) const {
+        return SegmentSpanIterator(first_, second_, index_ + n);
+    }
+
+    friend SegmentSpanIterator operator+(difference_type n, const SegmentSpanIterator& it) {
+        return it + n;
+    }
+
+    [[nodiscard]] SegmentSpanIterator operator-(difference_type n) const {
+        return SegmentSpanIterator(first_, second_, index_ - n);
+    }
+
+    [[nodiscard]] difference_type operator-(const SegmentSpanIterator& other) const {
+        return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+
+    [[nodiscard]] bool operator==(const SegmentSpanIterator& other) const {
+        return index_ == other.index_;
+    }
+
+    [[nodiscard]] auto operator<=>(const SegmentSpanIterator& other) const {
+        return index_ <=> other.index_;
+    }
+
+private:
+    [[nodiscard]] reference element(size_t n) const {
+        return (n < first_.size()) ? first_[n] : second_[n - first_.size()];
+    }
+
+    std::span<T> first_;
+    std::span<T> second_;
+    size_t index_ = 0;
+};
+
+
+// cheap non-owning view of ring elements split into at most two contiguous pieces.
+// its iterators carry the pieces themselves, so they stay valid after the range
+// object is gone and the range is a borrowed view
+template<typename T>
+class CSegmentRange : public std::ranges::view_interface<CSegmentRange<T>> {
+public:
+    using value_type = std::remove_cv_t<T>;
+    using reference = T&;
+    using iterator = SegmentSpanIterator<T>;
+
+    CSegmentRange() = default;
+
+    CSegmentRange(std::span<T> first, std::span<T> second)
+        : first_(first), second_(second) {}
+
+    // a range of T converts to a range of const T
+    template<typename U>
+        requires (!std::is_same_v<U, T> && std::is_convertible_v<U(*)[], T(*)[]>)
+    CSegmentRange(const CSegmentRange<U>& other)
+        : first_(other.first()), second_(other.second()) {}
+
+    // anything that hands out its elements as segments, CCirtucalBuffer included
+    template<typename Buffer>
+        requires (!std::is_same_v<std::remove_cvref_t<Buffer>, CSegmentRange>)
+                 && requires(const Buffer& buffer) { { buffer.segments().first() } -> std::convertible_to<std::span<T>>; }
+    explicit CSegmentRange(const Buffer& buffer)
+        : first_(buffer.segments().first()), second_(buffer.segments().second()) {}
+
+    [[nodiscard]] std::span<T> first() const {
+        return first_;
+    }
+
+    [[nodiscard]] std::span<T> second() const {
+        return second_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return first_.size() + second_.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size() == 0;
+    }
+
+    [[nodiscard]] reference operator[](size_t n) const {
+        return (n < first_.size()) ? first_[n] : second_[n - first_.size()];
+    }
+
+    [[nodiscard]] reference at(size_t n) const {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return operator[](n);
+    }
+
+    [[nodiscard]] reference front() const {
+        return at(0);
+    }
+
+    [[nodiscard]] reference back() const {
+        return at(size() - 1);
+    }
+
+    // logical [from, to) of this range, still at most two pieces
+    [[nodiscard]] CSegmentRange subrange(size_t from, size_t to) const {
+        if (from > to || to > size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        size_t split = first_.size();
+        if (to <= split) {
+            return CSegmentRange(first_.subspan(from, to - from), std::span<T>());
+        }
+        if (from >= split) {
+            return CSegmentRange(second_.subspan(from - split, to - from), std::span<T>());
+        }
+
+        return CSegmentRange(first_.subspan(from), second_.first(to - split));
+    }
+
+    [[nodiscard]] CSegmentRange subview(size_t from, size_t to) const {
+        return subrange(from, to);
+    }
+
+    [[nodiscard]] CSegmentRange first(size_t n) const {
+        return subrange(0, n);
+    }
+
+    [[nodiscard]] CSegmentRange last(size_t n) const {
+        if (n > size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return subrange(size() - n, size());
+    }
+
+    [[nodiscard]] iterator begin() const {
+        return iterator(first_, second_, 0);
+    }
+
+    [[nodiscard]] iterator end() const {
+        return iterator(first_, second_, size());
+    }
+
+    // one memcmp per overlap of the two split points, at most three,
+    // whenever equal values are equal bytes
+    template<typename U>
+    bool operator==(const CSegmentRange<U>& other) const {
+        if (size() != other.size()) {
+            return false;
+        }
+
+        bool equal = true;
+        forEachOverlap(other, [&equal](std::span<T> lhs, std::span<U> rhs) {
+            if constexpr (kBytewise && std::is_same_v<value_type, std::remove_cv_t<U>>) {
+                equal = equal && std::memcmp(lhs.data(), rhs.data(), lhs.size_bytes()) == 0;
+            } else {
+                equal = equal && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+            }
+        });
+
+        return equal;
+    }
+
+    // FNV-1a over the bytes when they fully define the value, otherwise over std::hash of every element
+    [[nodiscard]] size_t hash() const {
+        uint64_t h = kFnvOffset;
+        for (std::span<T> piece: {first_, second_}) {
+            if constexpr (kBytewise) {
+                for (std::byte b: std::as_bytes(piece)) {
+                    h = (h ^ static_cast<uint64_t>(b)) * kFnvPrime;
+                }
+            } else {
+                for (const value_type& val: piece) {
+                    h = (h ^ static_cast<uint64_t>(std::hash<value_type>()(val))) * kFnvPrime;
+                }
+            }
+        }
+
+        return static_cast<size_t>(h);
+    }
+
+private:
+
+    static constexpr bool kBytewise = std::has_unique_object_representations_v<value_type>;
+    static constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+    static constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+    // walks both ranges in lockstep, fn gets equally long contiguous pieces
+    template<typename U, typename Fn>
+    void forEachOverlap(const CSegmentRange<U>& other, Fn fn) const {
+        std::span<T> lhs[] = {first_, second_};
+        std::span<U> rhs[] = {other.first(), other.second()};
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < 2 && j < 2) {
+            if (lhs[i].empty()) {
+                ++i;
+                continue;
+            }
+            if (rhs[j].empty()) {
+                ++j;
+                continue;
+            }
+
+            size_t n = std::min(lhs[i].size(), rhs[j].size());
+            fn(lhs[i].first(n), rhs[j].first(n));
+            lhs[i] = lhs[i].subspan(n);
+            rhs[j] = rhs[j].subspan(n);
+        }
+    }
+
+    std::span<T> first_;
+    std::span<T> second_;
+};
+
+// segments(), range() and view() all hand out the same view type
+template<typename T>
+using CCirtucalBufferView = CSegmentRange<T>;
+
+
+template<typename T>
+inline constexpr bool std::ranges::enable_borrowed_range<CSegmentRange<T>> = true;
+
+template<typename T>
+struct std::hash<CSegmentRange<T>> {
+    size_t operator()(const CSegmentRange<T>& range) const {
+        return range.hash();
+    }
+};
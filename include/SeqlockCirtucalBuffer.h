@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+
+enum class ESeqlockRead {
+    Ok,
+    Empty,
+    Overrun,
+};
+
+
+// lossy telemetry ring: one writer that never waits, any number of readers.
+// every slot carries a version stamp, odd while the slot is being written,
+// so readers copy optimistically and detect torn or overwritten entries
+template<typename T>
+class CSeqlockCirtucalBuffer {
+public:
+
+    static_assert(std::is_trivially_copyable_v<T>, "slots are copied optimistically, T must be trivially copyable");
+
+    using value_type = T;
+    using const_reference = const T&;
+
+    explicit CSeqlockCirtucalBuffer(size_t n)
+        : capacity_(n)
+    {
+        if (capacity_ == 0) {
+            throw std::invalid_argument("capacity must be positive");
+        }
+
+        slots_ = new Slot[capacity_];
+    }
+
+    CSeqlockCirtucalBuffer(const CSeqlockCirtucalBuffer&) = delete;
+    CSeqlockCirtucalBuffer& operator=(const CSeqlockCirtucalBuffer&) = delete;
+
+    ~CSeqlockCirtucalBuffer() {
+        delete[] slots_;
+    }
+
+    // writer side, wait-free, the oldest entry is overwritten like in CCirtucalBuffer::push_back
+    void push_back(const_reference val) {
+        uint64_t seq = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[seq % capacity_];
+
+        slot.version.store(2 * seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&slot.value, &val, sizeof(T));
+        slot.version.store(stamp(seq), std::memory_order_release);
+
+        head_.store(seq + 1, std::memory_order_release);
+    }
+
+    // reads the entry at cursor and advances it; on Overrun the entry was lost
+    // and cursor is moved to the oldest entry that is still in the ring
+    ESeqlockRead read(uint64_t& cursor, T& out) const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (cursor >= head) {
+            return ESeqlockRead::Empty;
+        }
+
+        if (head - cursor > capacity_) {
+            cursor = head - capacity_;
+            return ESeqlockRead::Overrun;
+        }
+
+        if (!tryRead(cursor, out)) {
+            cursor = oldest();
+            return ESeqlockRead::Overrun;
+        }
+
+        ++cursor;
+        return ESeqlockRead::Ok;
+    }
+
+    // newest complete entry, false if nothing was written yet
+    bool read_latest(T& out) const {
+        while (true) {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            if (head == 0) {
+                return false;
+            }
+
+            if (tryRead(head - 1, out)) {
+                return true;
+            }
+        }
+    }
+
+    // sequence of the oldest entry still held by the ring
+    [[nodiscard]] uint64_t oldest() const {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        return (head > capacity_) ? head - capacity_ : 0;
+    }
+
+    // sequence the next push_back will get
+    [[nodiscard]] uint64_t sequence() const {
+        return head_.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+
+    struct Slot {
+        std::atomic<uint64_t> version{0};
+        T value{};
+    };
+
+    [[nodiscard]] static uint64_t stamp(uint64_t seq) {
+        return 2 * seq + 2;
+    }
+
+    // the copy may race with the writer, the second version check discards it if it did
+    bool tryRead(uint64_t seq, T& out) const {
+        const Slot& slot = slots_[seq % capacity_];
+
+        uint64_t before = slot.version.load(std::memory_order_acquire);
+        if (before != stamp(seq)) {
+            return false;
+        }
+
+        std::memcpy(&out, &slot.value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        return slot.version.load(std::memory_order_relaxed) == before;
+    }
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+
+    Slot* slots_;
+    size_t capacity_;
+
+};
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "Allocator.h"
+
+
+// row iterator, dereferences into a tuple of references to every column
+template<typename Buffer, typename Reference>
+class SoaIterator {
+public:
+    using value_type = typename Buffer::value_type;
+    using reference = Reference;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    SoaIterator() = default;
+
+    explicit SoaIterator(Buffer* buffer, size_t index)
+        : buffer_(buffer), index_(index) {}
+
+    [[nodiscard]] reference operator*() const {
+        return buffer_->row(index_);
+    }
+
+    [[nodiscard]] reference operator[](difference_type n) const {
+        return buffer_->row(index_ + n);
+    }
+
+    SoaIterator& operator++() {
+        ++index_;
+        return *this;
+    }
+
+    SoaIterator& operator--() {
+        --index_;
+        return *this;
+    }
+
+    SoaIterator operator++(int) {
+        SoaIterator tmp(*this);
+        ++index_;
+
+        return tmp;
+    }
+
+    SoaIterator operator--(int) {
+        SoaIterator tmp(*this);
+        --index_;
+
+        return tmp;
+    }
+
+    SoaIterator& operator+=(difference_type n) {
+        index_ += n;
+        return *this;
+    }
+
+    SoaIterator& operator-=(difference_type n) {
+        index_ -= n;
+        return *this;
+    }
+
+    [[nodiscard]] SoaIterator operator+(difference_type n) const {
+        return SoaIterator(buffer_, index_ + n);
+    }
+
+    friend SoaIterator operator+(difference_type n, const SoaIterator& it) {
+        return it + n;
+    }
+
+    [[nodiscard]] SoaIterator operator-(difference_type n) const {
+        return SoaIterator(buffer_, index_ - n);
+    }
+
+    [[nodiscard]] difference_type operator-(const SoaIterator& other) const {
+        return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+    }
+
+    [[nodiscard]] bool operator==(const SoaIterator& other) const {
+        return index_ == other.index_;
+    }
+
+    [[nodiscard]] auto operator<=>(const SoaIterator& other) const {
+        return index_ <=> other.index_;
+    }
+
+private:
+    Buffer* buffer_ = nullptr;
+    size_t index_ = 0;
+};
+
+
+// structure-of-arrays ring: one parallel ring per field, shared positions
+template<typename... Ts>
+class CSoaCirtucalBuffer {
+public:
+
+    static_assert(sizeof...(Ts) > 0, "at least one column is required");
+
+    using value_type = std::tuple<Ts...>;
+    using reference = std::tuple<Ts&...>;
+    using const_reference = std::tuple<const Ts&...>;
+    using iterator = SoaIterator<CSoaCirtucalBuffer, reference>;
+    using const_iterator = SoaIterator<const CSoaCirtucalBuffer, const_reference>;
+
+    template<size_t I>
+    using column_type = std::tuple_element_t<I, value_type>;
+
+    template<size_t I>
+    using segments_type = std::pair<std::span<column_type<I>>, std::span<column_type<I>>>;
+
+    template<size_t I>
+    using const_segments_type = std::pair<std::span<const column_type<I>>, std::span<const column_type<I>>>;
+
+    explicit CSoaCirtucalBuffer()
+        : CSoaCirtucalBuffer(0)
+    {}
+
+    explicit CSoaCirtucalBuffer(size_t n)
+        : capacity_(n + 1)
+    {
+        allocateColumns();
+    }
+
+    CSoaCirtucalBuffer(const CSoaCirtucalBuffer& other)
+        : capacity_(other.capacity_)
+    {
+        allocateColumns();
+        copyFrom(other);
+    }
+
+    ~CSoaCirtucalBuffer() {
+        deallocateColumns();
+    }
+
+    CSoaCirtucalBuffer& operator=(const CSoaCirtucalBuffer& other) {
+        if (this == &other) {
+            return *this;
+        }
+
+        if (capacity_ != other.capacity_) {
+            deallocateColumns();
+            capacity_ = other.capacity_;
+            allocateColumns();
+        }
+        copyFrom(other);
+
+        return *this;
+    }
+
+    void swap(CSoaCirtucalBuffer& other) {
+        std::swap(columns_, other.columns_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(write_pos_, other.write_pos_);
+        std::swap(reader_pos_, other.reader_pos_);
+    }
+
+    void push_back(const Ts&... vals) {
+        storeRow(write_pos_, std::index_sequence_for<Ts...>(), vals...);
+        write_pos_ = getIncrement(write_pos_);
+
+        if (write_pos_ == reader_pos_) {
+            reader_pos_ = getIncrement(reader_pos_);
+        }
+    }
+
+    void push_back(const value_type& row) {
+        std::apply([this](const Ts&... vals) { push_back(vals...); }, row);
+    }
+
+    void push_front(const Ts&... vals) {
+        reader_pos_ = getDecrement(reader_pos_);
+        storeRow(reader_pos_, std::index_sequence_for<Ts...>(), vals...);
+
+        if (write_pos_ == reader_pos_) {
+            write_pos_ = getDecrement(write_pos_);
+        }
+    }
+
+    void pop_front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        reader_pos_ = getIncrement(reader_pos_);
+    }
+
+    void pop_back() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        write_pos_ = getDecrement(write_pos_);
+    }
+
+    [[nodiscard]] reference front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return rowAt(reader_pos_);
+    }
+
+    [[nodiscard]] const_reference front() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return rowAt(reader_pos_);
+    }
+
+    [[nodiscard]] reference back() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return rowAt(getDecrement(write_pos_));
+    }
+
+    [[nodiscard]] const_reference back() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return rowAt(getDecrement(write_pos_));
+    }
+
+    [[nodiscard]] reference operator[](size_t n) {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return row(n);
+    }
+
+    [[nodiscard]] const_reference operator[](size_t n) const {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return row(n);
+    }
+
+    [[nodiscard]] reference at(size_t n) {
+        return operator[](n);
+    }
+
+    [[nodiscard]] const_reference at(size_t n) const {
+        return operator[](n);
+    }
+
+    // unchecked row access by logical index, used by the iterators
+    [[nodiscard]] reference row(size_t n) {
+        return rowAt(physical(n));
+    }
+
+    [[nodiscard]] const_reference row(size_t n) const {
+        return rowAt(physical(n));
+    }
+
+    // single field of the n-th row
+    template<size_t I>
+    [[nodiscard]] column_type<I>& column(size_t n) {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return std::get<I>(columns_)[physical(n)];
+    }
+
+    template<size_t I>
+    [[nodiscard]] const column_type<I>& column(size_t n) const {
+        if (n >= size()) {
+            throw std::out_of_range("Out of range!");
+        }
+
+        return std::get<I>(columns_)[physical(n)];
+    }
+
+    // live part of one column as at most two contiguous pieces, in logical order
+    template<size_t I>
+    [[nodiscard]] segments_type<I> segments() {
+        return columnSegments<column_type<I>>(std::get<I>(columns_));
+    }
+
+    template<size_t I>
+    [[nodiscard]] const_segments_type<I> segments() const {
+        return columnSegments<const column_type<I>>(std::get<I>(columns_));
+    }
+
+    [[nodiscard]] iterator begin() {
+        return iterator(this, 0);
+    }
+
+    [[nodiscard]] iterator end() {
+        return iterator(this, size());
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    [[nodiscard]] const_iterator cbegin() const {
+        return begin();
+    }
+
+    [[nodiscard]] const_iterator cend() const {
+        return end();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return write_pos_ == reader_pos_;
+    }
+
+    [[nodiscard]] bool full() const {
+        return write_pos_ == getDecrement(reader_pos_);
+    }
+
+    void clear() {
+        write_pos_ = 0;
+        reader_pos_ = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        if (write_pos_ >= reader_pos_) {
+            return write_pos_ - reader_pos_;
+        } else {
+            return capacity_ - (reader_pos_ - write_pos_);
+        }
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_ - 1;
+    }
+
+private:
+
+    [[nodiscard]] size_t getIncrement(size_t pos) const {
+        return (pos + 1) % capacity_;
+    }
+
+    [[nodiscard]] size_t getDecrement(size_t pos) const {
+        return (pos == 0) ? (capacity_ - 1) : (pos - 1);
+    }
+
+    template<typename Col>
+    [[nodiscard]] std::pair<std::span<Col>, std::span<Col>> columnSegments(Col* data) const {
+        if (write_pos_ >= reader_pos_) {
+            return {std::span<Col>(data + reader_pos_, write_pos_ - reader_pos_), std::span<Col>()};
+        }
+
+        return {std::span<Col>(data + reader_pos_, capacity_ - reader_pos_), std::span<Col>(data, write_pos_)};
+    }
+
+    [[nodiscard]] size_t physical(size_t n) const {
+        return (reader_pos_ + n) % capacity_;
+    }
+
+    [[nodiscard]] reference rowAt(size_t pos) {
+        return std::apply([pos](Ts*... data) { return reference(data[pos]...); }, columns_);
+    }
+
+    [[nodiscard]] const_reference rowAt(size_t pos) const {
+        return std::apply([pos](Ts*... data) { return const_reference(data[pos]...); }, columns_);
+    }
+
+    template<size_t... Is>
+    void storeRow(size_t pos, std::index_sequence<Is...>, const Ts&... vals) {
+        ((std::get<Is>(columns_)[pos] = vals), ...);
+    }
+
+    void allocateColumns() {
+        columns_ = std::tuple<Ts*...>(allocateColumn<Ts>()...);
+    }
+
+    void deallocateColumns() {
+        std::apply([this](Ts*... data) { (deallocateColumn(data), ...); }, columns_);
+    }
+
+    template<typename Col>
+    Col* allocateColumn() {
+        Col* data = CAllocator<Col>().allocate(capacity_);
+        std::uninitialized_value_construct_n(data, capacity_);
+
+        return data;
+    }
+
+    template<typename Col>
+    void deallocateColumn(Col* data) {
+        std::destroy_n(data, capacity_);
+        CAllocator<Col>().deallocate(data, capacity_);
+    }
+
+    // rows are copied column by column, so every copy is a straight pass over one array
+    void copyFrom(const CSoaCirtucalBuffer& other) {
+        copyColumns(other, std::index_sequence_for<Ts...>());
+        reader_pos_ = 0;
+        write_pos_ = other.size();
+    }
+
+    template<size_t... Is>
+    void copyColumns(const CSoaCirtucalBuffer& other, std::index_sequence<Is...>) {
+        (copyColumn<Is>(other), ...);
+    }
+
+    template<size_t I>
+    void copyColumn(const CSoaCirtucalBuffer& other) {
+        auto [first, second] = other.segments<I>();
+        column_type<I>* out = std::copy(first.begin(), first.end(), std::get<I>(columns_));
+        std::copy(second.begin(), second.end(), out);
+    }
+
+    size_t write_pos_ = 0;
+    size_t reader_pos_ = 0;
+
+    std::tuple<Ts*...> columns_;
+    size_t capacity_;
+
+};
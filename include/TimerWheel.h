@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+
+// refers to a scheduled timer; a stale handle (fired or cancelled timer) is
+// recognised by its generation even after the node was reused
+struct CTimerHandle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+
+// hierarchical hashed timing wheel: every level is a ring of slots indexed by
+// a slice of the expiry tick, level 0 advances one slot per tick and the
+// higher levels are cascaded down whenever the lower ones wrap around.
+// timers live in a fixed node pool and are linked into their slot intrusively,
+// so schedule and cancel are O(1) and never allocate
+template<typename Payload>
+class CTimerWheel {
+public:
+
+    // slot_bits is log2 of the slots per level, the wheel spans 2^(slot_bits * levels) ticks;
+    // longer delays are parked in the last level and re-placed on every cascade
+    explicit CTimerWheel(size_t max_timers, size_t slot_bits = 8, size_t levels = 4)
+        : capacity_(max_timers)
+        , slot_bits_(slot_bits)
+        , levels_(levels)
+    {
+        if (max_timers >= UINT32_MAX || slot_bits == 0 || levels == 0 || slot_bits * levels >= 64) {
+            throw std::invalid_argument("bad timer wheel parameters");
+        }
+
+        nodes_ = new Node[capacity_];
+        for (size_t i = 0; i < capacity_; i++) {
+            nodes_[i].next = (i + 1 < capacity_) ? i + 1 : kNil;
+        }
+        free_ = (capacity_ == 0) ? kNil : 0;
+
+        heads_ = new size_t[levels_ << slot_bits_];
+        for (size_t i = 0; i < (levels_ << slot_bits_); i++) {
+            heads_[i] = kNil;
+        }
+    }
+
+    CTimerWheel(const CTimerWheel&) = delete;
+    CTimerWheel& operator=(const CTimerWheel&) = delete;
+
+    ~CTimerWheel() {
+        delete[] nodes_;
+        delete[] heads_;
+    }
+
+    // fires on the first advance() that reaches now() + delay, a zero delay waits one tick
+    CTimerHandle schedule(uint64_t delay, const Payload& payload) {
+        if (free_ == kNil) {
+            throw std::length_error("timer pool is exhausted");
+        }
+
+        size_t i = free_;
+        free_ = nodes_[i].next;
+
+        Node& node = nodes_[i];
+        node.payload = payload;
+        node.expires = now_ + ((delay == 0) ? 1 : delay);
+        node.active = true;
+        place(i);
+        ++size_;
+
+        return {static_cast<uint32_t>(i), node.generation};
+    }
+
+    // false if the timer already fired or was cancelled
+    bool cancel(CTimerHandle handle) {
+        if (!active(handle)) {
+            return false;
+        }
+
+        unlink(handle.index);
+        release(handle.index);
+
+        return true;
+    }
+
+    [[nodiscard]] bool active(CTimerHandle handle) const {
+        return handle.index < capacity_ && nodes_[handle.index].active
+               && nodes_[handle.index].generation == handle.generation;
+    }
+
+    // moves the wheel forward tick by tick; on_expire(payload) runs for every timer
+    // that is due, a whole slot at a time. returns how many timers fired
+    template<typename Fn>
+    size_t advance(uint64_t ticks, Fn&& on_expire) {
+        size_t fired = 0;
+        for (uint64_t t = 0; t < ticks; t++) {
+            ++now_;
+            cascade();
+
+            // the callback may cancel timers of this slot or schedule new ones
+            size_t& head = heads_[bucket(0, now_)];
+            while (head != kNil) {
+                size_t i = head;
+                unlink(i);
+
+                Payload payload = std::move(nodes_[i].payload);
+                release(i);
+                on_expire(payload);
+                ++fired;
+            }
+        }
+
+        return fired;
+    }
+
+    [[nodiscard]] uint64_t now() const {
+        return now_;
+    }
+
+    // timers still pending
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_;
+    }
+
+    [[nodiscard]] size_t levels() const {
+        return levels_;
+    }
+
+private:
+
+    static constexpr size_t kNil = SIZE_MAX;
+
+    struct Node {
+        Payload payload{};
+        uint64_t expires = 0;
+        uint32_t generation = 0;
+        bool active = false;
+
+        size_t bucket = kNil;
+        size_t prev = kNil;
+        size_t next = kNil;
+    };
+
+    [[nodiscard]] size_t bucket(size_t level, uint64_t tick) const {
+        size_t mask = (size_t(1) << slot_bits_) - 1;
+        return (level << slot_bits_) + ((tick >> (slot_bits_ * level)) & mask);
+    }
+
+    // the lowest level whose span still covers the remaining delay
+    void place(size_t i) {
+        uint64_t span = uint64_t(1) << (slot_bits_ * levels_);
+        uint64_t target = (nodes_[i].expires - now_ < span) ? nodes_[i].expires : now_ + span - 1;
+
+        size_t level = 0;
+        while (level + 1 < levels_ && ((target - now_) >> (slot_bits_ * (level + 1))) != 0) {
+            ++level;
+        }
+
+        link(i, bucket(level, target));
+    }
+
+    // every level whose lower levels just wrapped to zero hands its current slot down
+    void cascade() {
+        size_t level = 1;
+        while (level < levels_ && (now_ & ((uint64_t(1) << (slot_bits_ * level)) - 1)) == 0) {
+            ++level;
+        }
+
+        while (--level > 0) {
+            size_t i = heads_[bucket(level, now_)];
+            heads_[bucket(level, now_)] = kNil;
+            while (i != kNil) {
+                size_t next = nodes_[i].next;
+                place(i);
+                i = next;
+            }
+        }
+    }
+
+    void link(size_t i, size_t b) {
+        Node& node = nodes_[i];
+        node.bucket = b;
+        node.prev = kNil;
+        node.next = heads_[b];
+        if (node.next != kNil) {
+            nodes_[node.next].prev = i;
+        }
+        heads_[b] = i;
+    }
+
+    void unlink(size_t i) {
+        Node& node = nodes_[i];
+        if (node.prev != kNil) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            heads_[node.bucket] = node.next;
+        }
+
+        if (node.next != kNil) {
+            nodes_[node.next].prev = node.prev;
+        }
+    }
+
+    void release(size_t i) {
+        Node& node = nodes_[i];
+        node.active = false;
+        ++node.generation;
+        node.next = free_;
+        free_ = i;
+        --size_;
+    }
+
+    Node* nodes_;
+    size_t* heads_;
+    size_t capacity_;
+    size_t free_;
+    size_t size_ = 0;
+
+    size_t slot_bits_;
+    size_t levels_;
+    uint64_t now_ = 0;
+
+};
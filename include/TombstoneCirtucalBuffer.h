@@ -0,0 +1,413 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "Allocator.h"
+
+
+// ring with O(1) erase anywhere: an erased element leaves a dead slot behind
+// instead of shifting its neighbours. the first and the last slot are always
+// live, so dead slots only ever sit in the middle; pop_front drops the ones it
+// uncovers, and a bulk compaction packs the ring once too many of them pile up.
+//
+// slots are addressed by a monotonic sequence number, so iterators survive
+// erase and pop_front of other elements and are invalidated only by compaction
+template<typename T, typename Alloc = CAllocator<T>>
+class CTombstoneCirtucalBuffer {
+public:
+
+    using value_type = T;
+    using pointer = T*;
+    using reference = T&;
+    using const_reference = const T&;
+
+    using allocator_type = Alloc;
+
+    // U is T or const T
+    template<typename U>
+    class TombstoneIterator {
+    public:
+        using value_type = std::remove_cv_t<U>;
+        using pointer = U*;
+        using reference = U&;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::bidirectional_iterator_tag;
+
+        TombstoneIterator() = default;
+
+        // iterator converts to const_iterator, not the other way round
+        template<typename V>
+            requires (std::is_same_v<const V, U> && !std::is_same_v<V, U>)
+        TombstoneIterator(const TombstoneIterator<V>& other)
+            : buffer_(other.buffer_), seq_(other.seq_) {}
+
+        [[nodiscard]] reference operator*() const {
+            return buffer_->element(seq_);
+        }
+
+        [[nodiscard]] pointer operator->() const {
+            return &buffer_->element(seq_);
+        }
+
+        TombstoneIterator& operator++() {
+            seq_ = buffer_->nextLive(seq_ + 1);
+            return *this;
+        }
+
+        TombstoneIterator& operator--() {
+            seq_ = buffer_->prevLive(seq_ - 1);
+            return *this;
+        }
+
+        TombstoneIterator operator++(int) {
+            TombstoneIterator tmp(*this);
+            ++*this;
+
+            return tmp;
+        }
+
+        TombstoneIterator operator--(int) {
+            TombstoneIterator tmp(*this);
+            --*this;
+
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator==(const TombstoneIterator& other) const {
+            return seq_ == other.seq_;
+        }
+
+    private:
+        friend class CTombstoneCirtucalBuffer;
+
+        template<typename>
+        friend class TombstoneIterator;
+
+        TombstoneIterator(const CTombstoneCirtucalBuffer* buffer, uint64_t seq)
+            : buffer_(buffer), seq_(seq) {}
+
+        const CTombstoneCirtucalBuffer* buffer_ = nullptr;
+        uint64_t seq_ = 0;
+    };
+
+    using iterator = TombstoneIterator<T>;
+    using const_iterator = TombstoneIterator<const T>;
+
+    // compaction starts once more than max_dead_ratio of the occupied slots are dead
+    explicit CTombstoneCirtucalBuffer(size_t n, double max_dead_ratio = 0.5)
+        : capacity_(n)
+        , max_dead_ratio_(max_dead_ratio)
+        , alloc_(Alloc())
+    {
+        data_ = alloc_.allocate(capacity_);
+        dead_ = new bool[capacity_]();
+    }
+
+    CTombstoneCirtucalBuffer(const std::initializer_list<value_type>& il)
+        : CTombstoneCirtucalBuffer(il.size())
+    {
+        for (const_reference val: il) {
+            push_back(val);
+        }
+    }
+
+    CTombstoneCirtucalBuffer(const CTombstoneCirtucalBuffer& other)
+        : CTombstoneCirtucalBuffer(other.capacity_, other.max_dead_ratio_)
+    {
+        for (const_reference val: other) {
+            push_back(val);
+        }
+    }
+
+    ~CTombstoneCirtucalBuffer() {
+        clear();
+        alloc_.deallocate(data_, capacity_);
+        delete[] dead_;
+    }
+
+    CTombstoneCirtucalBuffer& operator=(const CTombstoneCirtucalBuffer& other) {
+        if (this != &other) {
+            CTombstoneCirtucalBuffer tmp(other);
+            swap(tmp);
+        }
+
+        return *this;
+    }
+
+    bool operator==(const CTombstoneCirtucalBuffer& other) const {
+        return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const CTombstoneCirtucalBuffer& other) const {
+        return !operator==(other);
+    }
+
+    // a full ring first gets its dead slots back, and only then drops the oldest element
+    void push_back(const_reference val) {
+        if (capacity_ == 0) {
+            return;
+        }
+
+        if (tail_ - head_ == capacity_) {
+            if (size_ == capacity_) {
+                pop_front();
+            } else {
+                compact();
+            }
+        }
+
+        new (slot(tail_)) T(val);
+        dead_[index(tail_)] = false;
+        ++tail_;
+        ++size_;
+    }
+
+    void pop_front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        std::destroy_at(slot(head_));
+        --size_;
+        head_ = nextLive(head_ + 1);
+        trimIfEmpty();
+    }
+
+    void pop_back() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        uint64_t last = tail_ - 1;
+        std::destroy_at(slot(last));
+        --size_;
+
+        // the first slot is live, so anything left has a live slot before last
+        tail_ = (size_ == 0) ? last : prevLive(last - 1) + 1;
+        trimIfEmpty();
+    }
+
+    // O(1) unless it pushes the dead ratio over the threshold; end() is left alone,
+    // an element that was already erased can't be erased again
+    iterator erase(const_iterator Where) {
+        uint64_t seq = Where.seq_;
+        if (seq < head_ || seq >= tail_) {
+            return end();
+        }
+
+        if (dead_[index(seq)]) {
+            throw std::out_of_range("element was already erased");
+        }
+
+        if (seq == head_) {
+            pop_front();
+            return begin();
+        }
+
+        if (seq + 1 == tail_) {
+            pop_back();
+            return end();
+        }
+
+        std::destroy_at(slot(seq));
+        dead_[index(seq)] = true;
+        --size_;
+
+        uint64_t next = nextLive(seq + 1);
+        if (static_cast<double>(tombstones()) > max_dead_ratio_ * static_cast<double>(tail_ - head_)) {
+            next = compact(next);
+        }
+
+        return iterator(this, next);
+    }
+
+    [[nodiscard]] reference front() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(head_);
+    }
+
+    [[nodiscard]] const_reference front() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(head_);
+    }
+
+    [[nodiscard]] reference back() {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(tail_ - 1);
+    }
+
+    [[nodiscard]] const_reference back() const {
+        if (empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        return element(tail_ - 1);
+    }
+
+    [[nodiscard]] iterator begin() {
+        return iterator(this, head_);
+    }
+
+    [[nodiscard]] iterator end() {
+        return iterator(this, tail_);
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return const_iterator(this, head_);
+    }
+
+    [[nodiscard]] const_iterator end() const {
+        return const_iterator(this, tail_);
+    }
+
+    [[nodiscard]] const_iterator cbegin() const {
+        return begin();
+    }
+
+    [[nodiscard]] const_iterator cend() const {
+        return end();
+    }
+
+    // live elements only
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] bool full() const {
+        return size_ == capacity_;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return capacity_;
+    }
+
+    [[nodiscard]] size_t tombstones() const {
+        return (tail_ - head_) - size_;
+    }
+
+    // packs the live elements towards the front, invalidates iterators
+    void compact() {
+        compact(tail_);
+    }
+
+    void clear() {
+        while (!empty()) {
+            pop_back();
+        }
+    }
+
+    void swap(CTombstoneCirtucalBuffer& other) {
+        std::swap(data_, other.data_);
+        std::swap(dead_, other.dead_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(size_, other.size_);
+        std::swap(max_dead_ratio_, other.max_dead_ratio_);
+        std::swap(alloc_, other.alloc_);
+    }
+
+    allocator_type get_allocator() const {
+        return alloc_;
+    }
+
+private:
+
+    [[nodiscard]] size_t index(uint64_t seq) const {
+        return seq % capacity_;
+    }
+
+    [[nodiscard]] pointer slot(uint64_t seq) const {
+        return data_ + index(seq);
+    }
+
+    [[nodiscard]] reference element(uint64_t seq) const {
+        return *std::launder(slot(seq));
+    }
+
+    // the first live slot at or after seq, tail_ if there is none
+    [[nodiscard]] uint64_t nextLive(uint64_t seq) const {
+        while (seq < tail_ && dead_[index(seq)]) {
+            ++seq;
+        }
+
+        return seq;
+    }
+
+    // the last live slot at or before seq; the first slot is always live
+    [[nodiscard]] uint64_t prevLive(uint64_t seq) const {
+        while (seq > head_ && dead_[index(seq)]) {
+            --seq;
+        }
+
+        return seq;
+    }
+
+    void trimIfEmpty() {
+        if (size_ == 0) {
+            head_ = tail_;
+        }
+    }
+
+    // returns where the element that sat at follow ended up
+    uint64_t compact(uint64_t follow) {
+        uint64_t write = head_;
+        uint64_t moved = tail_;
+        for (uint64_t read = head_; read < tail_; read++) {
+            if (read == follow) {
+                moved = write;
+            }
+
+            if (dead_[index(read)]) {
+                continue;
+            }
+
+            if (read != write) {
+                new (slot(write)) T(std::move(element(read)));
+                std::destroy_at(slot(read));
+                dead_[index(write)] = false;
+            }
+            ++write;
+        }
+
+        if (follow >= tail_) {
+            moved = write;
+        }
+        tail_ = write;
+
+        return moved;
+    }
+
+    pointer data_;
+    bool* dead_;
+    size_t capacity_;
+
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+    size_t size_ = 0;
+
+    double max_dead_ratio_;
+    Alloc alloc_;
+
+};
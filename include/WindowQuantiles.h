@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include "CirtucalBuffer.h"
+
+
+// exact order statistics: a treap with subtree sizes over a fixed node pool,
+// O(log n) insert, erase and k-th element, no allocation after construction
+template<typename T>
+class CExactQuantiles {
+public:
+
+    explicit CExactQuantiles(size_t n)
+        : capacity_(n)
+    {
+        nodes_ = new Node[capacity_ + 1];
+        for (size_t i = 1; i < capacity_; i++) {
+            nodes_[i].left = i + 1;
+        }
+        free_ = (capacity_ == 0) ? kNil : 1;
+    }
+
+    CExactQuantiles(const CExactQuantiles&) = delete;
+    CExactQuantiles& operator=(const CExactQuantiles&) = delete;
+
+    ~CExactQuantiles() {
+        delete[] nodes_;
+    }
+
+    void insert(const T& val) {
+        if (free_ == kNil) {
+            throw std::length_error("order statistic tree is full");
+        }
+
+        size_t node = free_;
+        free_ = nodes_[node].left;
+        nodes_[node] = Node{val, nextPriority(), kNil, kNil, 1};
+
+        auto [less, rest] = split(root_, val, false);
+        root_ = merge(merge(less, node), rest);
+    }
+
+    // removes one element equal to val, if there is one
+    void erase(const T& val) {
+        auto [less, rest] = split(root_, val, false);
+        auto [equal, greater] = split(rest, val, true);
+
+        if (equal != kNil) {
+            size_t node = equal;
+            equal = merge(nodes_[node].left, nodes_[node].right);
+            nodes_[node].left = free_;
+            free_ = node;
+        }
+
+        root_ = merge(less, merge(equal, greater));
+    }
+
+    // k-th smallest, k is zero based
+    [[nodiscard]] T kth(size_t k) const {
+        size_t node = root_;
+        while (true) {
+            size_t left = sizeOf(nodes_[node].left);
+            if (k < left) {
+                node = nodes_[node].left;
+            } else if (k == left) {
+                return nodes_[node].key;
+            } else {
+                k -= left + 1;
+                node = nodes_[node].right;
+            }
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return sizeOf(root_);
+    }
+
+private:
+
+    // index 0 is the empty tree, the pool starts at 1
+    static constexpr size_t kNil = 0;
+
+    struct Node {
+        T key{};
+        uint32_t priority = 0;
+        size_t left = kNil;
+        size_t right = kNil;
+        size_t size = 0;
+    };
+
+    [[nodiscard]] size_t sizeOf(size_t node) const {
+        return nodes_[node].size;
+    }
+
+    void update(size_t node) {
+        nodes_[node].size = 1 + sizeOf(nodes_[node].left) + sizeOf(nodes_[node].right);
+    }
+
+    uint32_t nextPriority() {
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+        return seed_;
+    }
+
+    // (keys < val, keys >= val), or (keys <= val, keys > val) when inclusive
+    std::pair<size_t, size_t> split(size_t node, const T& val, bool inclusive) {
+        if (node == kNil) {
+            return {kNil, kNil};
+        }
+
+        bool goes_left = inclusive ? !(val < nodes_[node].key) : nodes_[node].key < val;
+        if (goes_left) {
+            auto [less, rest] = split(nodes_[node].right, val, inclusive);
+            nodes_[node].right = less;
+            update(node);
+            return {node, rest};
+        }
+
+        auto [less, rest] = split(nodes_[node].left, val, inclusive);
+        nodes_[node].left = rest;
+        update(node);
+        return {less, node};
+    }
+
+    size_t merge(size_t left, size_t right) {
+        if (left == kNil || right == kNil) {
+            return (left == kNil) ? right : left;
+        }
+
+        if (nodes_[left].priority > nodes_[right].priority) {
+            nodes_[left].right = merge(nodes_[left].right, right);
+            update(left);
+            return left;
+        }
+
+        nodes_[right].left = merge(left, nodes_[right].left);
+        update(right);
+        return right;
+    }
+
+    Node* nodes_;
+    size_t capacity_;
+    size_t root_ = kNil;
+    size_t free_;
+    uint32_t seed_ = 2463534242u;
+
+};
+
+
+// approximate order statistics in fixed memory: log-spaced buckets, every
+// answer within relative_accuracy of a true sample in [min_value, max_value]
+template<typename T>
+class CApproxQuantiles {
+public:
+
+    CApproxQuantiles(size_t, double relative_accuracy = 0.01, double min_value = 1e-3, double max_value = 1e9)
+        : gamma_((1 + relative_accuracy) / (1 - relative_accuracy))
+        , log_gamma_(std::log(gamma_))
+        , min_value_(min_value)
+    {
+        if (relative_accuracy <= 0 || relative_accuracy >= 1 || min_value <= 0 || max_value <= min_value) {
+            throw std::invalid_argument("bad sketch parameters");
+        }
+
+        offset_ = static_cast<long>(std::ceil(std::log(min_value) / log_gamma_));
+        buckets_ = static_cast<size_t>(std::ceil(std::log(max_value) / log_gamma_) - offset_) + 1;
+        counts_ = new size_t[buckets_]();
+    }
+
+    CApproxQuantiles(const CApproxQuantiles&) = delete;
+    CApproxQuantiles& operator=(const CApproxQuantiles&) = delete;
+
+    ~CApproxQuantiles() {
+        delete[] counts_;
+    }
+
+    void insert(const T& val) {
+        ++counts_[bucket(val)];
+        ++size_;
+    }
+
+    void erase(const T& val) {
+        --counts_[bucket(val)];
+        --size_;
+    }
+
+    [[nodiscard]] T kth(size_t k) const {
+        size_t seen = 0;
+        size_t i = 0;
+        while (seen + counts_[i] <= k) {
+            seen += counts_[i++];
+        }
+
+        // middle of the bucket (gamma^(i-1), gamma^i] in relative terms
+        double upper = std::exp(static_cast<double>(static_cast<long>(i) + offset_) * log_gamma_);
+        return static_cast<T>(2 * upper / (gamma_ + 1));
+    }
+
+    [[nodiscard]] size_t size() const {
+        return size_;
+    }
+
+    [[nodiscard]] size_t buckets() const {
+        return buckets_;
+    }
+
+private:
+
+    // values out of range are clamped into the first or the last bucket
+    [[nodiscard]] size_t bucket(const T& val) const {
+        double v = std::max(static_cast<double>(val), min_value_);
+        long i = static_cast<long>(std::ceil(std::log(v) / log_gamma_)) - offset_;
+
+        return static_cast<size_t>(std::clamp<long>(i, 0, static_cast<long>(buckets_) - 1));
+    }
+
+    double gamma_;
+    double log_gamma_;
+    double min_value_;
+    long offset_;
+
+    size_t* counts_;
+    size_t buckets_;
+    size_t size_ = 0;
+
+};
+
+
+// the last n samples together with an order statistic structure that follows
+// every eviction, p50/p99 queries never sort the window
+template<typename T, typename Quantiles = CExactQuantiles<T>>
+class CWindowQuantiles {
+public:
+
+    using value_type = T;
+
+    template<typename... Args>
+    explicit CWindowQuantiles(size_t n, Args&&... args)
+        : window_(n)
+        , quantiles_(n, std::forward<Args>(args)...)
+    {}
+
+    void push_back(const T& val) {
+        if (window_.full()) {
+            quantiles_.erase(window_.front());
+        }
+
+        window_.push_back(val);
+        quantiles_.insert(val);
+    }
+
+    void pop_front() {
+        quantiles_.erase(window_.front());
+        window_.pop_front();
+    }
+
+    // nearest-rank quantile, q in [0, 1]
+    [[nodiscard]] T quantile(double q) const {
+        if (window_.empty()) {
+            throw std::out_of_range("buffer is empty");
+        }
+
+        size_t n = window_.size();
+        size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(n)));
+
+        return quantiles_.kth(std::clamp<size_t>(rank, 1, n) - 1);
+    }
+
+    [[nodiscard]] T median() const {
+        return quantile(0.5);
+    }
+
+    [[nodiscard]] const CCirtucalBuffer<T>& window() const {
+        return window_;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return window_.size();
+    }
+
+    [[nodiscard]] bool empty() const {
+        return window_.empty();
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return window_.capacity();
+    }
+
+private:
+    CCirtucalBuffer<T> window_;
+    Quantiles quantiles_;
+};
@@ -0,0 +1,469 @@
+#include <BroadcastCirtucalBuffer.h>
+#include <ConcurrentCirtucalBufferExt.h>
+#include <Pipeline.h>
+#include <SeqlockCirtucalBuffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// usage: buffer_stress [--producers N] [--consumers M] [--items K] [--capacity C] [--cores 0,2,4]
+// without --producers/--consumers every topology runs one after another:
+//   1:1  CBroadcastCirtucalBuffer with a single reader
+//   N:1  CConcurrentCirtucalBufferExt, bounded to C items in flight
+//   1:N  CBroadcastCirtucalBuffer, every consumer sees every item
+//   N:M  one bounded CConcurrentCirtucalBufferExt per consumer, producers deal items round-robin
+//   seq  CSeqlockCirtucalBuffer, lossy: readers may be overrun, but never see a torn or repeated item
+//   pipe CPipeline, a pass-through stage in front of the sink
+// every ring holds C items, so a slow consumer pushes back on its producers.
+// exits with 1 if any item was lost (outside seq), torn or delivered twice, with 2 on bad arguments
+
+namespace {
+
+struct Item {
+    uint32_t producer = 0;
+    uint64_t seq = 0;
+    uint64_t check = 0;
+    int64_t stamp = 0;
+};
+
+struct Options {
+    size_t producers = 0;
+    size_t consumers = 0;
+    size_t items = 1000000;
+    size_t capacity = 1024;
+    std::vector<int> cores;
+};
+
+// what one consumer saw
+struct Tally {
+    std::vector<int64_t> latencies;
+    std::vector<uint8_t> seen;
+    size_t torn = 0;
+};
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t checkOf(uint32_t producer, uint64_t seq) {
+    return (seq * 0x9e3779b97f4a7c15ULL) ^ producer;
+}
+
+// threads take the given cores round-robin: producers first, then consumers
+int coreFor(const Options& options, size_t thread) {
+    return options.cores.empty() ? -1 : options.cores[thread % options.cores.size()];
+}
+
+// a thread that can't be pinned would skew every number, so it ends the run
+void pin(const Options& options, size_t thread) {
+#ifdef __linux__
+    int core = coreFor(options, thread);
+    if (core < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        std::fprintf(stderr, "cannot pin a thread to core %d: %s\n", core, std::strerror(error));
+        std::fflush(stderr);
+        std::_Exit(2);
+    }
+#endif
+}
+
+void record(const Options& options, Tally& tally, const Item& item) {
+    tally.latencies.push_back(nowNs() - item.stamp);
+    if (item.seq >= options.items || item.check != checkOf(item.producer, item.seq)) {
+        ++tally.torn;
+        return;
+    }
+
+    uint8_t& seen = tally.seen[item.producer * options.items + item.seq];
+    if (seen < UINT8_MAX) {
+        ++seen;
+    }
+}
+
+Item makeItem(uint32_t producer, uint64_t seq) {
+    return Item{producer, seq, checkOf(producer, seq), nowNs()};
+}
+
+// CConcurrentCirtucalBufferExt grows without bound; here producers wait for one of
+// capacity places instead, so a slow consumer pushes back as it would on a ring
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : queue_(capacity), capacity_(capacity) {}
+
+    void push(const Item& item) {
+        size_t used = in_flight_.load(std::memory_order_relaxed);
+        while (used == capacity_ || !in_flight_.compare_exchange_weak(used, used + 1, std::memory_order_acquire)) {
+            if (used == capacity_) {
+                std::this_thread::yield();
+                used = in_flight_.load(std::memory_order_relaxed);
+            }
+        }
+
+        queue_.push_back(item);
+    }
+
+    bool try_pop(Item& item) {
+        if (!queue_.try_pop_front(item)) {
+            return false;
+        }
+
+        in_flight_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return queue_.empty();
+    }
+
+private:
+    CConcurrentCirtucalBufferExt<Item> queue_;
+    std::atomic<size_t> in_flight_{0};
+    size_t capacity_;
+};
+
+// runs producers and consumers, the consumers stop once producers_left is zero and their source is dry
+template<typename Produce, typename Consume>
+double run(const Options& options, size_t producers, size_t consumers, std::vector<Tally>& tallies,
+           Produce produce, Consume consume) {
+    tallies.assign(consumers, Tally());
+    for (Tally& tally: tallies) {
+        tally.seen.assign(options.items * producers, 0);
+        tally.latencies.reserve(options.items * producers);
+    }
+
+    std::atomic<size_t> producers_left{producers};
+    std::vector<std::thread> threads;
+
+    int64_t start = nowNs();
+    for (size_t c = 0; c < consumers; c++) {
+        threads.emplace_back([&, c]() {
+            pin(options, producers + c);
+            consume(c, tallies[c], producers_left);
+        });
+    }
+    for (size_t p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            pin(options, p);
+            produce(static_cast<uint32_t>(p));
+            producers_left.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    return static_cast<double>(nowNs() - start) / 1e9;
+}
+
+// producer p deals its items over the consumers' queues round-robin, with one consumer it is plain N:1
+double runQueues(const Options& options, size_t producers, size_t consumers, std::vector<Tally>& tallies) {
+    std::vector<std::unique_ptr<BoundedQueue>> queues;
+    for (size_t c = 0; c < consumers; c++) {
+        queues.push_back(std::make_unique<BoundedQueue>(options.capacity));
+    }
+
+    auto produce = [&](uint32_t p) {
+        for (uint64_t i = 0; i < options.items; i++) {
+            queues[(p + i) % consumers]->push(makeItem(p, i));
+        }
+    };
+    auto consume = [&](size_t c, Tally& tally, std::atomic<size_t>& producers_left) {
+        BoundedQueue& queue = *queues[c];
+        Item item;
+        while (true) {
+            bool finished = producers_left.load(std::memory_order_acquire) == 0;
+            if (queue.try_pop(item)) {
+                record(options, tally, item);
+            } else if (finished && queue.empty()) {
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    return run(options, producers, consumers, tallies, produce, consume);
+}
+
+double runBroadcast(const Options& options, size_t consumers, std::vector<Tally>& tallies) {
+    CBroadcastCirtucalBuffer<Item> ring(options.capacity, consumers);
+    std::vector<size_t> readers;
+    for (size_t c = 0; c < consumers; c++) {
+        readers.push_back(ring.register_reader());
+    }
+
+    auto produce = [&](uint32_t p) {
+        for (uint64_t i = 0; i < options.items; i++) {
+            ring.push_back(makeItem(p, i));
+        }
+    };
+    auto consume = [&](size_t c, Tally& tally, std::atomic<size_t>& producers_left) {
+        while (true) {
+            bool finished = producers_left.load(std::memory_order_acquire) == 0;
+            CSegmentRange<const Item> items = ring.claim(readers[c]);
+            if (items.empty()) {
+                if (finished) {
+                    return;
+                }
+
+                std::this_thread::yield();
+                continue;
+            }
+
+            for (const Item& item: items) {
+                record(options, tally, item);
+            }
+            ring.release(readers[c], items.size());
+        }
+    };
+
+    return run(options, 1, consumers, tallies, produce, consume);
+}
+
+// the writer never waits, readers count what they missed as lost
+double runSeqlock(const Options& options, size_t readers, std::vector<Tally>& tallies) {
+    CSeqlockCirtucalBuffer<Item> ring(options.capacity);
+
+    auto produce = [&](uint32_t p) {
+        for (uint64_t i = 0; i < options.items; i++) {
+            ring.push_back(makeItem(p, i));
+        }
+    };
+    auto consume = [&](size_t, Tally& tally, std::atomic<size_t>& producers_left) {
+        uint64_t cursor = 0;
+        Item item;
+        while (true) {
+            bool finished = producers_left.load(std::memory_order_acquire) == 0;
+            ESeqlockRead result = ring.read(cursor, item);
+            if (result == ESeqlockRead::Ok) {
+                record(options, tally, item);
+            } else if (result == ESeqlockRead::Empty) {
+                if (finished) {
+                    return;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    return run(options, 1, readers, tallies, produce, consume);
+}
+
+// the sink records on the last stage thread, the consumer thread only closes and waits
+double runPipeline(const Options& options, std::vector<Tally>& tallies) {
+    CPipeline<Item> pipeline = make_pipeline<Item>(options.capacity, std::max<size_t>(1, options.capacity / 4))
+        .stage([](const Item& item) { return item; }, coreFor(options, 2))
+        .sink([&](const Item& item) { record(options, tallies[0], item); }, coreFor(options, 3));
+
+    // run() sizes the tallies before the producer starts the stages
+    auto produce = [&](uint32_t p) {
+        pipeline.start();
+        for (uint64_t i = 0; i < options.items; i++) {
+            pipeline.push(makeItem(p, i));
+        }
+    };
+    auto consume = [&](size_t, Tally&, std::atomic<size_t>& producers_left) {
+        while (producers_left.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+
+        pipeline.close();
+        pipeline.wait();
+    };
+
+    return run(options, 1, 1, tallies, produce, consume);
+}
+
+int64_t percentile(const std::vector<int64_t>& sorted, double q) {
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    size_t rank = static_cast<size_t>(q * static_cast<double>(sorted.size() - 1));
+    return sorted[rank];
+}
+
+enum class Delivery {
+    Once,       // every item reaches exactly one consumer
+    Everyone,   // every consumer sees every item once
+    Lossy,      // every consumer sees an item at most once
+};
+
+bool report(const Options& options, const char* name, size_t producers, size_t consumers,
+            Delivery delivery, double seconds, std::vector<Tally>& tallies) {
+    size_t lost = 0;
+    size_t duplicates = 0;
+    size_t torn = 0;
+    std::vector<int64_t> latencies;
+
+    if (delivery == Delivery::Once) {
+        for (size_t i = 0; i < options.items * producers; i++) {
+            size_t seen = 0;
+            for (const Tally& tally: tallies) {
+                seen += tally.seen[i];
+            }
+            lost += (seen == 0);
+            duplicates += (seen > 1) ? seen - 1 : 0;
+        }
+    } else {
+        for (const Tally& tally: tallies) {
+            for (uint8_t seen: tally.seen) {
+                lost += (seen == 0);
+                duplicates += (seen > 1) ? seen - 1 : 0;
+            }
+        }
+    }
+
+    for (const Tally& tally: tallies) {
+        torn += tally.torn;
+        latencies.insert(latencies.end(), tally.latencies.begin(), tally.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::printf("%-4s %2zu:%-2zu  %10.0f items/s  p50 %8lld ns  p99 %8lld ns  p99.9 %8lld ns  "
+                "lost %zu  duplicates %zu  torn %zu\n",
+                name, producers, consumers, static_cast<double>(latencies.size()) / seconds,
+                static_cast<long long>(percentile(latencies, 0.5)),
+                static_cast<long long>(percentile(latencies, 0.99)),
+                static_cast<long long>(percentile(latencies, 0.999)),
+                lost, duplicates, torn);
+
+    return (lost == 0 || delivery == Delivery::Lossy) && duplicates == 0 && torn == 0;
+}
+
+bool runTopology(const Options& options, size_t producers, size_t consumers) {
+    std::vector<Tally> tallies;
+    if (producers > 1) {
+        double seconds = runQueues(options, producers, consumers, tallies);
+        return report(options, (consumers > 1) ? "N:M" : "N:1", producers, consumers, Delivery::Once, seconds, tallies);
+    }
+
+    double seconds = runBroadcast(options, consumers, tallies);
+    return report(options, (consumers > 1) ? "1:N" : "1:1", 1, consumers, Delivery::Everyone, seconds, tallies);
+}
+
+bool runSeqlockTopology(const Options& options, size_t readers) {
+    std::vector<Tally> tallies;
+    double seconds = runSeqlock(options, readers, tallies);
+    return report(options, "seq", 1, readers, Delivery::Lossy, seconds, tallies);
+}
+
+bool runPipelineTopology(const Options& options) {
+    std::vector<Tally> tallies;
+    double seconds = runPipeline(options, tallies);
+    return report(options, "pipe", 1, 1, Delivery::Once, seconds, tallies);
+}
+
+bool parseSize(const char* text, size_t& value) {
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || text[0] == '-') {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+bool parseCores(const char* list, std::vector<int>& cores) {
+    std::string text(list);
+    size_t from = 0;
+    while (from <= text.size()) {
+        size_t to = text.find(',', from);
+        if (to == std::string::npos) {
+            to = text.size();
+        }
+
+        size_t core = 0;
+        if (!parseSize(text.substr(from, to - from).c_str(), core)) {
+            return false;
+        }
+#ifdef __linux__
+        if (core >= CPU_SETSIZE) {
+            return false;
+        }
+#endif
+        cores.push_back(static_cast<int>(core));
+        from = to + 1;
+    }
+
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            std::fprintf(stderr, "option %s needs a value\n", argv[i]);
+            return 2;
+        }
+
+        bool ok = true;
+        if (std::strcmp(argv[i], "--producers") == 0) {
+            ok = parseSize(argv[i + 1], options.producers);
+        } else if (std::strcmp(argv[i], "--consumers") == 0) {
+            ok = parseSize(argv[i + 1], options.consumers);
+        } else if (std::strcmp(argv[i], "--items") == 0) {
+            ok = parseSize(argv[i + 1], options.items);
+        } else if (std::strcmp(argv[i], "--capacity") == 0) {
+            ok = parseSize(argv[i + 1], options.capacity);
+        } else if (std::strcmp(argv[i], "--cores") == 0) {
+            ok = parseCores(argv[i + 1], options.cores);
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "bad value %s for %s\n", argv[i + 1], argv[i]);
+            return 2;
+        }
+    }
+
+    if (options.items == 0 || options.capacity == 0) {
+        std::fprintf(stderr, "items and capacity must be positive\n");
+        return 2;
+    }
+
+    bool ok = true;
+    if (options.producers != 0 || options.consumers != 0) {
+        ok = runTopology(options, std::max<size_t>(options.producers, 1), std::max<size_t>(options.consumers, 1));
+    } else {
+        ok = runTopology(options, 1, 1) && ok;
+        ok = runTopology(options, 4, 1) && ok;
+        ok = runTopology(options, 1, 4) && ok;
+        ok = runTopology(options, 4, 4) && ok;
+        ok = runSeqlockTopology(options, 4) && ok;
+        ok = runPipelineTopology(options) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
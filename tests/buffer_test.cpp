@@ -1,7 +1,24 @@
 #include <CirtucalBuffer.h>
 #include <CirtucalBufferExt.h>
+#include <SoaCirtucalBuffer.h>
+#include <BroadcastCirtucalBuffer.h>
+#include <SeqlockCirtucalBuffer.h>
+#include <ParallelAlgorithms.h>
+#include <Checkpoint.h>
+#include <KeyedCirtucalBuffer.h>
+#include <CascadeCirtucalBuffer.h>
+#include <WindowQuantiles.h>
+#include <ConcurrentCirtucalBufferExt.h>
+#include <ChunkedCirtucalBufferExt.h>
+#include <Pipeline.h>
+#include <TombstoneCirtucalBuffer.h>
+#include <CompressedCirtucalBuffer.h>
+#include <TimerWheel.h>
 
 #include "gtest/gtest.h"
+#include <sstream>
+#include <numeric>
+#include <thread>
 #include <tuple>
 
 // without meaning
@@ -368,3 +385,1274 @@ TEST(CirtucalBufferTestSuite, BufferExtTest) {
 
     ASSERT_EQ(buff, CCirtucalBufferExt<int>({7, 6, 5, 1, 2, 3, 4}));
 }
+
+
+TEST(SoaCirtucalBufferTestSuite, PushBackTest) {
+    CSoaCirtucalBuffer<long, double, int> buff(3);
+    buff.push_back(1, 10.5, 100);
+    buff.push_back(2, 20.5, 200);
+    buff.push_back(3, 30.5, 300);
+    buff.push_back(4, 40.5, 400);
+
+    ASSERT_EQ(buff.size(), 3);
+    ASSERT_EQ(std::get<0>(buff.front()), 2);
+    ASSERT_EQ(std::get<1>(buff.back()), 40.5);
+    ASSERT_EQ(buff.column<2>(1), 300);
+
+    std::get<2>(buff[0]) = 7;
+    ASSERT_EQ(buff.column<2>(0), 7);
+    ASSERT_THROW(buff[3], std::out_of_range);
+
+    buff.pop_front();
+    buff.pop_back();
+    ASSERT_EQ(buff.size(), 1);
+    ASSERT_EQ(buff.row(0), std::make_tuple(3L, 30.5, 300));
+}
+
+TEST(SoaCirtucalBufferTestSuite, SegmentsTest) {
+    CSoaCirtucalBuffer<int, char> buff(4);
+    for (int i = 0; i < 7; i++) {
+        buff.push_back(i, static_cast<char>('a' + i));
+    }
+
+    auto [first, second] = buff.segments<0>();
+    ASSERT_EQ(first.size() + second.size(), 4);
+    ASSERT_FALSE(second.empty());
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(std::as_const(buff).segments<0>().first[0])>>);
+
+    int max = 0;
+    for (int val: first) {
+        max = std::max(max, val);
+    }
+    for (int val: second) {
+        max = std::max(max, val);
+    }
+    ASSERT_EQ(max, 6);
+
+    CSoaCirtucalBuffer<int, char> copy = buff;
+    auto [copy_first, copy_second] = copy.segments<1>();
+    ASSERT_EQ(copy_first.size(), 4);
+    ASSERT_TRUE(copy_second.empty());
+    ASSERT_EQ(copy_first[0], 'd');
+}
+
+TEST(SoaCirtucalBufferTestSuite, IteratorTest) {
+    CSoaCirtucalBuffer<int, int> buff(3);
+    buff.push_back(5, 50);
+    buff.push_back(6, 60);
+    buff.push_back(7, 70);
+    buff.push_back(8, 80);
+
+    int sum = 0;
+    for (auto [key, val]: buff) {
+        sum += val;
+        val = key;
+    }
+    ASSERT_EQ(sum, 210);
+    ASSERT_EQ(buff.column<1>(2), 8);
+
+    auto it = std::find_if(buff.begin(), buff.end(), [](const auto& row) { return std::get<0>(row) == 7; });
+    ASSERT_EQ(it - buff.begin(), 1);
+    ASSERT_EQ(buff.end() - buff.begin(), 3);
+    ASSERT_TRUE(2 + buff.begin() == buff.begin() + 2);
+    ASSERT_TRUE(buff.begin() < 1 + buff.begin());
+    static_assert(std::random_access_iterator<decltype(buff.begin())>);
+}
+
+struct TimedEvent {
+    long time;
+    int val;
+};
+
+TEST(CirtucalBufferTestSuite, KeyedLookupTest) {
+    CCirtucalBuffer<int> buff(5);
+    for (int i = 1; i <= 8; i++) {
+        buff.push_back(i * 10);
+    }
+    // 40 50 60 70 80, wrapped over the end of the storage
+
+    ASSERT_EQ(*buff.lower_bound(55), 60);
+    ASSERT_EQ(*buff.lower_bound(70), 70);
+    ASSERT_EQ(*buff.upper_bound(70), 80);
+    ASSERT_EQ(buff.lower_bound(100), buff.end());
+    ASSERT_EQ(buff.lower_bound(0), buff.begin());
+
+    CSegmentRange<int> window = buff.range(45, 75);
+    ASSERT_EQ(window.size(), 3);
+    ASSERT_EQ(window.front(), 50);
+    ASSERT_EQ(window.back(), 70);
+    ASSERT_TRUE(buff.range(81, 90).empty());
+
+    // iterators do not point into the temporary range
+    auto it = buff.range(45, 75).begin();
+    auto last = buff.range(45, 75).end();
+    ASSERT_EQ(std::vector<int>(it, last), std::vector<int>({50, 60, 70}));
+
+    ASSERT_EQ(buff.evict_older_than(65), 3);
+    ASSERT_EQ(buff, CCirtucalBuffer<int>({70, 80}));
+}
+
+TEST(CirtucalBufferTestSuite, KeyedProjectionTest) {
+    CCirtucalBuffer<TimedEvent> buff(4);
+    for (int i = 0; i < 6; i++) {
+        buff.push_back({100 + i, i});
+    }
+
+    CSegmentRange<TimedEvent> window = buff.range(103L, 104L, &TimedEvent::time);
+    ASSERT_EQ(window.size(), 2);
+    ASSERT_EQ(window[0].val, 3);
+    ASSERT_EQ(window[1].val, 4);
+
+    int sum = 0;
+    for (const TimedEvent& event: window) {
+        sum += event.val;
+    }
+    ASSERT_EQ(sum, 7);
+
+    ASSERT_EQ(buff.evict_older_than(105L, &TimedEvent::time), 3);
+    ASSERT_EQ(buff.size(), 1);
+    ASSERT_EQ(buff.front().val, 5);
+}
+
+template<typename Ring>
+concept ClaimableFrom = requires(Ring& ring) { ring.claim(0); };
+
+TEST(BroadcastCirtucalBufferTestSuite, ClaimReleaseTest) {
+    CBroadcastCirtucalBuffer<int> buff(4);
+    size_t reader1 = buff.register_reader();
+    size_t reader2 = buff.register_reader();
+
+    ASSERT_TRUE(buff.try_push_back(1));
+    ASSERT_TRUE(buff.try_push_back(2));
+    ASSERT_TRUE(buff.try_push_back(3));
+
+    CSegmentRange<const int> batch = buff.claim(reader1);
+    ASSERT_EQ(batch.size(), 3);
+    ASSERT_EQ(batch[2], 3);
+    // claiming moves the reader's cursor, so a const buffer cannot claim
+    static_assert(!ClaimableFrom<const CBroadcastCirtucalBuffer<int>>);
+    static_assert(ClaimableFrom<CBroadcastCirtucalBuffer<int>>);
+    buff.release(reader1, 3);
+
+    std::initializer_list<int> il = {4, 5, 6};
+    ASSERT_EQ(buff.try_push_back(il.begin(), il.end()), 1);
+    ASSERT_FALSE(buff.try_push_back(7));
+
+    ASSERT_EQ(buff.claim(reader2).size(), 4);
+    buff.release(reader2, 2);
+    ASSERT_EQ(buff.try_push_back(il.begin() + 1, il.end()), 2);
+
+    batch = buff.claim(reader2);
+    ASSERT_EQ(batch.size(), 4);
+    ASSERT_FALSE(batch.second().empty());
+    ASSERT_EQ(batch.front(), 3);
+    ASSERT_EQ(batch.back(), 6);
+
+    buff.unregister_reader(reader2);
+    ASSERT_EQ(buff.available(reader1), 3);
+    ASSERT_TRUE(buff.try_push_back(7));
+    ASSERT_FALSE(buff.try_push_back(8));
+
+    // only what the last claim handed out can be released
+    ASSERT_THROW(buff.release(reader1, 1), std::out_of_range);
+    ASSERT_EQ(buff.claim(reader1).size(), 4);
+    ASSERT_THROW(buff.release(reader1, 5), std::out_of_range);
+    buff.release(reader1, 4);
+    ASSERT_TRUE(buff.try_push_back(8));
+}
+
+TEST(BroadcastCirtucalBufferTestSuite, RegisterWhileWritingTest) {
+    CBroadcastCirtucalBuffer<int> buff(8, 4);
+    size_t drain = buff.register_reader();
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        int i = 0;
+        while (!stop.load()) {
+            if (!buff.try_push_back(i++)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    // a reader that joins mid-stream never sees more than one lap of data
+    bool bounded = true;
+    for (int round = 0; round < 2000; round++) {
+        buff.release(drain, buff.claim(drain).size());
+
+        size_t late = buff.register_reader();
+        bounded = bounded && buff.claim(late).size() <= buff.capacity();
+        buff.unregister_reader(late);
+    }
+
+    stop = true;
+    writer.join();
+    ASSERT_TRUE(bounded);
+}
+
+TEST(BroadcastCirtucalBufferTestSuite, ConcurrentReadersTest) {
+    const int count = 100000;
+    const int readers_count = 4;
+    CBroadcastCirtucalBuffer<int> buff(64);
+
+    size_t readers[readers_count];
+    for (size_t& reader: readers) {
+        reader = buff.register_reader();
+    }
+
+    long long sums[readers_count] = {};
+    bool ordered[readers_count] = {};
+    std::thread threads[readers_count];
+    for (int i = 0; i < readers_count; i++) {
+        threads[i] = std::thread([&, i]() {
+            int expected = 0;
+            ordered[i] = true;
+            while (expected < count) {
+                CSegmentRange<const int> batch = buff.claim(readers[i]);
+                if (batch.empty()) {
+                    std::this_thread::yield();
+                }
+                for (int val: batch) {
+                    ordered[i] = ordered[i] && val == expected++;
+                    sums[i] += val;
+                }
+                buff.release(readers[i], batch.size());
+            }
+        });
+    }
+
+    for (int i = 0; i < count; i++) {
+        buff.push_back(i);
+    }
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < readers_count; i++) {
+        ASSERT_TRUE(ordered[i]);
+        ASSERT_EQ(sums[i], 1LL * count * (count - 1) / 2);
+    }
+}
+
+struct TelemetrySample {
+    long seq;
+    long check;
+};
+
+TEST(SeqlockCirtucalBufferTestSuite, OverrunTest) {
+    CSeqlockCirtucalBuffer<int> buff(4);
+    uint64_t cursor = 0;
+    int val = 0;
+
+    ASSERT_EQ(buff.read(cursor, val), ESeqlockRead::Empty);
+    ASSERT_FALSE(buff.read_latest(val));
+
+    buff.push_back(1);
+    buff.push_back(2);
+    ASSERT_EQ(buff.read(cursor, val), ESeqlockRead::Ok);
+    ASSERT_EQ(val, 1);
+
+    for (int i = 3; i <= 10; i++) {
+        buff.push_back(i);
+    }
+
+    ASSERT_EQ(buff.read(cursor, val), ESeqlockRead::Overrun);
+    ASSERT_EQ(cursor, buff.oldest());
+    ASSERT_EQ(buff.read(cursor, val), ESeqlockRead::Ok);
+    ASSERT_EQ(val, 7);
+
+    ASSERT_TRUE(buff.read_latest(val));
+    ASSERT_EQ(val, 10);
+}
+
+TEST(SeqlockCirtucalBufferTestSuite, ConcurrentReadTest) {
+    const long count = 200000;
+    CSeqlockCirtucalBuffer<TelemetrySample> buff(16);
+
+    bool consistent = true;
+    long last = -1;
+    std::thread reader([&]() {
+        uint64_t cursor = 0;
+        TelemetrySample sample{};
+        while (last != count - 1) {
+            if (buff.read(cursor, sample) != ESeqlockRead::Ok) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            consistent = consistent && sample.check == sample.seq * 3 && sample.seq > last;
+            last = sample.seq;
+        }
+    });
+
+    for (long i = 0; i < count; i++) {
+        buff.push_back({i, i * 3});
+    }
+    reader.join();
+
+    ASSERT_TRUE(consistent);
+}
+
+TEST(ParallelAlgorithmsTestSuite, ForEachReduceTest) {
+    const int count = 100000;
+    CCirtucalBuffer<long> buff(count);
+    for (int i = 0; i < count + count / 3; i++) {
+        buff.push_back(i);
+    }
+    ASSERT_FALSE(buff.segments().second().empty());
+
+    parallel_for_each(buff, [](long& val) { val *= 2; });
+    ASSERT_EQ(buff.front(), 2L * (count / 3));
+    ASSERT_EQ(buff.back(), 2L * (count + count / 3 - 1));
+
+    long expected = std::accumulate(buff.begin(), buff.end(), 0L);
+    ASSERT_EQ(parallel_reduce(buff, 0L), expected);
+    ASSERT_EQ(parallel_reduce(buff, 0L, [](long a, long b) { return std::max(a, b); }), buff.back());
+}
+
+TEST(ParallelAlgorithmsTestSuite, TransformSortTest) {
+    const int count = 50000;
+    CCirtucalBuffer<int> buff(count);
+    for (int i = 0; i < count * 2; i++) {
+        buff.push_back((i * 7919) % 100003);
+    }
+
+    std::unique_ptr<int[]> doubled(new int[count]);
+    ASSERT_EQ(parallel_transform(buff, doubled.get(), [](int val) { return val * 2; }), doubled.get() + count);
+    for (int i = 0; i < count; i++) {
+        ASSERT_EQ(doubled[i], buff[i] * 2);
+    }
+
+    std::unique_ptr<int[]> sorted(new int[count]);
+    parallel_sort_copy(buff, sorted.get());
+    ASSERT_TRUE(std::is_sorted(sorted.get(), sorted.get() + count));
+    ASSERT_EQ(std::accumulate(sorted.get(), sorted.get() + count, 0L), std::accumulate(buff.begin(), buff.end(), 0L));
+
+    parallel_sort_copy(buff, sorted.get(), std::greater<>());
+    ASSERT_TRUE(std::is_sorted(sorted.get(), sorted.get() + count, std::greater<>()));
+}
+
+TEST(ParallelAlgorithmsTestSuite, ErrorsAndResultTypesTest) {
+    const int count = 100000;
+    CCirtucalBuffer<int> buff(count);
+    for (int i = 0; i < count + count / 2; i++) {
+        buff.push_back(i % 10);
+    }
+
+    ASSERT_THROW(parallel_for_each(buff, [](int val) {
+        if (val == 7) {
+            throw std::runtime_error("worker failed");
+        }
+    }), std::runtime_error);
+
+    // the result type only needs to be constructible from an element
+    struct Sum {
+        explicit Sum(long val) : total(val) {}
+        long total;
+    };
+    Sum sum = parallel_reduce(buff, Sum(0), [](Sum acc, auto val) {
+        if constexpr (std::is_same_v<decltype(val), Sum>) {
+            return Sum(acc.total + val.total);
+        } else {
+            return Sum(acc.total + val);
+        }
+    });
+    ASSERT_EQ(sum.total, std::accumulate(buff.begin(), buff.end(), 0L));
+}
+
+// stores only the meaningful fields, without the padding
+struct HardTestObjCodec {
+    template<typename Sink>
+    static void encode(Sink& out, const HardTestObj& val) {
+        out.write(&val.val1, sizeof(val.val1));
+        out.write(&val.val2, sizeof(val.val2));
+    }
+
+    template<typename Source>
+    static void decode(Source& in, HardTestObj& val) {
+        in.read(&val.val1, sizeof(val.val1));
+        in.read(&val.val2, sizeof(val.val2));
+    }
+};
+
+TEST(CheckpointTestSuite, SaveLoadTest) {
+    CCirtucalBuffer<int> buff(5);
+    for (int i = 0; i < 8; i++) {
+        buff.push_back(i);
+    }
+
+    std::stringstream stream;
+    CCheckpoint<int>::save(buff, stream);
+    ASSERT_EQ(stream.str().size(), sizeof(CCheckpointHeader) + 5 * sizeof(int));
+
+    CCirtucalBuffer<int> loaded(1);
+    CCheckpoint<int>::load(loaded, stream);
+    ASSERT_EQ(loaded.capacity(), 5);
+    ASSERT_EQ(loaded, CCirtucalBuffer<int>({3, 4, 5, 6, 7}));
+
+    std::string bytes = stream.str();
+    bytes[sizeof(CCheckpointHeader) + 1] ^= 1;
+    std::stringstream corrupted(bytes);
+    ASSERT_THROW(CCheckpoint<int>::load(loaded, corrupted), std::runtime_error);
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 2));
+    ASSERT_THROW(CCheckpoint<int>::load(loaded, truncated), std::runtime_error);
+    ASSERT_EQ(loaded, CCirtucalBuffer<int>({3, 4, 5, 6, 7}));
+}
+
+TEST(CheckpointTestSuite, HostileHeaderTest) {
+    CCirtucalBuffer<int> buff({1, 2, 3});
+    std::stringstream stream;
+    CCheckpoint<int>::save(buff, stream);
+    std::string bytes = stream.str();
+
+    auto patched = [&bytes](auto patch) {
+        CCheckpointHeader header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        patch(header);
+
+        std::string copy = bytes;
+        std::memcpy(copy.data(), &header, sizeof(header));
+        return std::stringstream(copy);
+    };
+
+    // rejected from the header alone, nothing is allocated
+    CCirtucalBuffer<int> loaded(1);
+    auto huge = patched([](CCheckpointHeader& header) { header.capacity = uint64_t(1) << 60; });
+    ASSERT_THROW(CCheckpoint<int>::load(loaded, huge), std::runtime_error);
+
+    auto too_long = patched([](CCheckpointHeader& header) { header.size = header.count = 1000; header.capacity = 1000; });
+    ASSERT_THROW(CCheckpoint<int>::load(loaded, too_long), std::runtime_error);
+
+    std::stringstream limited(bytes);
+    ASSERT_THROW(CCheckpoint<int>::load(loaded, limited, 2), std::runtime_error);
+    ASSERT_EQ(loaded.capacity(), 1);
+
+    std::stringstream fits(bytes);
+    CCheckpoint<int>::load(loaded, fits, 3);
+    ASSERT_EQ(loaded, buff);
+}
+
+TEST(CheckpointTestSuite, FdAndCodecTest) {
+    CCirtucalBuffer<HardTestObj> buff(3);
+    buff.emplace_back(1, true);
+    buff.emplace_back(2, false);
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    CCheckpoint<HardTestObj, HardTestObjCodec>::save(buff, fds[1]);
+    close(fds[1]);
+
+    CCirtucalBuffer<HardTestObj> loaded;
+    CCheckpoint<HardTestObj, HardTestObjCodec>::load(loaded, fds[0]);
+    close(fds[0]);
+
+    ASSERT_EQ(loaded.capacity(), 3);
+    ASSERT_EQ(loaded.size(), 2);
+    ASSERT_EQ(loaded.at(0).val1, 1);
+    ASSERT_TRUE(loaded.at(0).val2);
+    ASSERT_EQ(loaded.at(1).val1, 2);
+    ASSERT_FALSE(loaded.at(1).val2);
+}
+
+TEST(CheckpointTestSuite, IncrementalTest) {
+    CCheckpointCirtucalBuffer<int> buff(4);
+    buff.push_back(1);
+    buff.push_back(2);
+
+    std::stringstream full;
+    CCheckpoint<int>::save_incremental(buff, full);
+
+    CCheckpointCirtucalBuffer<int> restored(0);
+    CCheckpoint<int>::load(restored, full);
+    ASSERT_EQ(restored, CCirtucalBuffer<int>({1, 2}));
+    ASSERT_EQ(restored.generation(), buff.generation());
+
+    buff.push_back(3);
+    buff.push_back(4);
+    buff.push_back(5);
+    buff.pop_front();
+
+    std::stringstream delta;
+    CCheckpoint<int>::save_incremental(buff, delta);
+    ASSERT_EQ(delta.str().size(), sizeof(CCheckpointHeader) + 3 * sizeof(int));
+
+    CCheckpoint<int>::load(restored, delta);
+    ASSERT_EQ(restored, CCirtucalBuffer<int>({3, 4, 5}));
+
+    buff.pop_back();
+    std::stringstream dirty;
+    CCheckpoint<int>::save_incremental(buff, dirty);
+    ASSERT_EQ(dirty.str().size(), sizeof(CCheckpointHeader) + 2 * sizeof(int));
+
+    CCheckpoint<int>::load(restored, dirty);
+    ASSERT_EQ(restored, CCirtucalBuffer<int>({3, 4}));
+
+    // every way of changing the ring other than appending forces a full snapshot
+    buff.resize(1);
+    ASSERT_TRUE(buff.dirty());
+    CCheckpoint<int>::save_incremental(buff, dirty);
+    buff.modify([](CCirtucalBuffer<int>& ring) { ring[0] = 9; });
+    ASSERT_TRUE(buff.dirty());
+    CCheckpoint<int>::save_incremental(buff, dirty);
+
+    CCheckpoint<int>::load(restored, dirty);
+    CCheckpoint<int>::load(restored, dirty);
+    ASSERT_EQ(restored, CCirtucalBuffer<int>({9}));
+}
+
+TEST(CheckpointTestSuite, DeltaBaseTest) {
+    CCheckpointCirtucalBuffer<int> buff(4);
+    buff.push_back(1);
+
+    std::stringstream full;
+    CCheckpoint<int>::save_incremental(buff, full);
+    CCheckpointCirtucalBuffer<int> restored(0);
+    CCheckpoint<int>::load(restored, full);
+
+    buff.push_back(2);
+    std::stringstream delta;
+    CCheckpoint<int>::save_incremental(buff, delta);
+    std::string bytes = delta.str();
+
+    // applying it twice, to a buffer that missed the base or to a plain ring is refused
+    std::stringstream once(bytes);
+    CCheckpoint<int>::load(restored, once);
+    std::stringstream twice(bytes);
+    ASSERT_THROW(CCheckpoint<int>::load(restored, twice), std::runtime_error);
+    ASSERT_EQ(restored, CCirtucalBuffer<int>({1, 2}));
+
+    CCheckpointCirtucalBuffer<int> other({1});
+    std::stringstream foreign(bytes);
+    ASSERT_THROW(CCheckpoint<int>::load(other, foreign), std::runtime_error);
+
+    CCirtucalBuffer<int> plain({1});
+    std::stringstream untracked(bytes);
+    ASSERT_THROW(CCheckpoint<int>::load(plain, untracked), std::runtime_error);
+}
+
+template<typename T>
+struct CountingAllocator : CAllocator<T> {
+    static inline size_t allocations = 0;
+
+    T* allocate(std::ptrdiff_t n) {
+        ++allocations;
+        return CAllocator<T>::allocate(n);
+    }
+};
+
+TEST(CirtucalBufferTestSuite, InlineStorageTest) {
+    using SmallBuffer = CCirtucalBuffer<int, CountingAllocator<int>, 4>;
+    CountingAllocator<int>::allocations = 0;
+
+    SmallBuffer buff1(4);
+    for (int i = 0; i < 6; i++) {
+        buff1.push_back(i);
+    }
+    SmallBuffer buff2 = buff1;
+    ASSERT_EQ(CountingAllocator<int>::allocations, 0);
+    ASSERT_EQ(buff2, SmallBuffer({2, 3, 4, 5}));
+
+    SmallBuffer big(10, 7);
+    ASSERT_EQ(CountingAllocator<int>::allocations, 1);
+
+    big.swap(buff1);
+    ASSERT_EQ(big, SmallBuffer({2, 3, 4, 5}));
+    ASSERT_EQ(buff1, SmallBuffer(10, 7));
+    ASSERT_EQ(buff1.capacity(), 10);
+
+    buff2.resize(6);
+    ASSERT_EQ(buff2.size(), 6);
+    ASSERT_EQ(buff2.at(3), 5);
+    ASSERT_EQ(buff2.at(5), 0);
+}
+
+TEST(CirtucalBufferTestSuite, StorageReuseTest) {
+    using Buffer = CCirtucalBuffer<int, CountingAllocator<int>, 0>;
+
+    Buffer buff1(100, 1);
+    Buffer buff2(50, 2);
+    Buffer buff3(200, 3);
+    CountingAllocator<int>::allocations = 0;
+
+    buff1 = buff2;
+    ASSERT_EQ(buff1, buff2);
+    ASSERT_EQ(buff1.capacity(), 50);
+
+    buff1.push_back(4);
+    ASSERT_EQ(buff1.size(), 50);
+    ASSERT_EQ(buff1.back(), 4);
+
+    buff1.assign(buff3.begin(), buff3.begin() + 80);
+    ASSERT_EQ(buff1.size(), 80);
+    ASSERT_EQ(buff1.capacity(), 80);
+    ASSERT_EQ(CountingAllocator<int>::allocations, 0);
+
+    buff1 = buff3;
+    ASSERT_EQ(buff1, buff3);
+    ASSERT_EQ(CountingAllocator<int>::allocations, 1);
+}
+
+TEST(CirtucalBufferTestSuite, InsertAtEndTest) {
+    CCirtucalBuffer<int> buff({1, 2, 3});
+    buff.push_back(4);
+    buff.insert(buff.end(), 5);
+    ASSERT_EQ(buff, CCirtucalBuffer<int>({2, 3, 4, 5}));
+}
+
+struct Message {
+    int id;
+    int payload;
+};
+
+TEST(KeyedCirtucalBufferTestSuite, EvictionTest) {
+    CKeyedCirtucalBuffer<int> buff(3);
+    buff.push_back(1);
+    buff.push_back(2);
+    buff.push_back(3);
+    ASSERT_TRUE(buff.contains(1));
+
+    buff.push_back(4);
+    ASSERT_FALSE(buff.contains(1));
+    ASSERT_TRUE(buff.contains(2));
+    ASSERT_TRUE(buff.contains(4));
+    ASSERT_EQ(*buff.find(3), 3);
+    ASSERT_EQ(buff.find(1), buff.end());
+    static_assert(std::is_same_v<decltype(*buff.find(3)), const int&>);
+    static_assert(std::is_same_v<decltype(buff.front()), const int&>);
+
+    buff.pop_front();
+    ASSERT_FALSE(buff.contains(2));
+    ASSERT_EQ(buff.size(), 2);
+
+    buff.clear();
+    ASSERT_FALSE(buff.contains(3));
+    ASSERT_TRUE(buff.empty());
+}
+
+TEST(KeyedCirtucalBufferTestSuite, DedupWindowTest) {
+    const int window = 64;
+    CKeyedCirtucalBuffer<Message, int Message::*> buff(window, &Message::id);
+
+    int accepted = 0;
+    for (int i = 0; i < 10000; i++) {
+        int id = ((i / 2) * 37) % 97;
+        if (buff.push_back_unique({id, i})) {
+            ++accepted;
+        }
+
+        ASSERT_LE(buff.size(), window);
+        for (size_t j = 0; j < buff.size(); j++) {
+            ASSERT_EQ(buff.find(buff[j].id)->id, buff[j].id);
+        }
+    }
+
+    ASSERT_EQ(accepted, 5000);
+    ASSERT_FALSE(buff.contains(97));
+
+    CKeyedCirtucalBuffer<Message, int Message::*> copy = buff;
+    ASSERT_EQ(copy.find(buff.back().id)->payload, buff.back().payload);
+}
+
+TEST(CascadeCirtucalBufferTestSuite, FoldTest) {
+    CCascadeCirtucalBuffer<double> cascade({{6, 0}, {4, 3}, {2, 2}});
+    for (uint64_t t = 0; t < 24; t++) {
+        cascade.push_back(t, static_cast<double>(t));
+    }
+
+    ASSERT_EQ(cascade.tiers(), 3);
+    ASSERT_EQ(cascade.tier(0).size(), 6);
+    ASSERT_EQ(cascade.tier(0).front().time, 18);
+
+    // blocks of 3 raw samples: 0-2, 3-5, ... 21-23
+    ASSERT_EQ(cascade.tier(1).size(), 4);
+    ASSERT_EQ(cascade.tier(1).front().time, 12);
+    ASSERT_EQ(cascade.tier(1).back().value, 22.0);
+
+    // blocks of 2 tier 1 samples: 0-5, 6-11, 12-17, 18-23
+    ASSERT_EQ(cascade.tier(2).size(), 2);
+    ASSERT_EQ(cascade.tier(2).front().time, 12);
+    ASSERT_EQ(cascade.tier(2).front().value, 14.5);
+}
+
+TEST(CascadeCirtucalBufferTestSuite, QueryTest) {
+    CCascadeCirtucalBuffer<int, CMaxAggregator<int>> cascade({{10, 0}, {10, 5}, {10, 10}});
+    for (uint64_t t = 0; t < 400; t++) {
+        cascade.push_back(t, static_cast<int>(t % 7));
+    }
+
+    auto recent = cascade.query(395, 399);
+    ASSERT_EQ(recent.tier, 0);
+    ASSERT_EQ(recent.samples.size(), 5);
+    ASSERT_EQ(recent.samples.front().time, 395);
+
+    auto hour = cascade.query(360, 399);
+    ASSERT_EQ(hour.tier, 1);
+    ASSERT_EQ(hour.samples.size(), 8);
+    ASSERT_EQ(hour.samples.front().value, 6);
+
+    auto day = cascade.query(0, 399);
+    ASSERT_EQ(day.tier, 2);
+    ASSERT_EQ(day.samples.size(), 8);
+
+    CCascadeCirtucalBuffer<int, CLastAggregator<int>> empty({{4, 0}, {4, 2}});
+    ASSERT_TRUE(empty.query(0, 10).samples.empty());
+
+    using Cascade = CCascadeCirtucalBuffer<int, CLastAggregator<int>>;
+    ASSERT_THROW(Cascade({{4, 0}, {4, 0}}), std::invalid_argument);
+    ASSERT_THROW(Cascade({}), std::invalid_argument);
+}
+
+TEST(WindowQuantilesTestSuite, ExactTest) {
+    const size_t window = 101;
+    CWindowQuantiles<int> quantiles(window);
+    ASSERT_THROW(quantiles.median(), std::out_of_range);
+
+    unsigned seed = 12345;
+    for (int i = 0; i < 2000; i++) {
+        seed = seed * 1103515245 + 12345;
+        quantiles.push_back(static_cast<int>((seed >> 16) % 500));
+
+        if (i % 97 == 0) {
+            CCirtucalBuffer<int> sorted = quantiles.window();
+            std::sort(sorted.begin(), sorted.end());
+            size_t n = sorted.size();
+
+            ASSERT_EQ(quantiles.quantile(0.0), sorted[0]);
+            ASSERT_EQ(quantiles.median(), sorted[(n + 1) / 2 - 1]);
+            ASSERT_EQ(quantiles.quantile(0.99), sorted[static_cast<size_t>(std::ceil(0.99 * n)) - 1]);
+            ASSERT_EQ(quantiles.quantile(1.0), sorted[n - 1]);
+        }
+    }
+
+    ASSERT_EQ(quantiles.size(), window);
+    quantiles.pop_front();
+    ASSERT_EQ(quantiles.size(), window - 1);
+}
+
+TEST(WindowQuantilesTestSuite, ApproxTest) {
+    const double accuracy = 0.01;
+    CWindowQuantiles<double, CApproxQuantiles<double>> quantiles(1000, accuracy, 0.1, 1e6);
+
+    for (int i = 1; i <= 5000; i++) {
+        quantiles.push_back(static_cast<double>(i));
+    }
+
+    // the window holds 4001..5000
+    ASSERT_NEAR(quantiles.median(), 4500.0, 4500.0 * accuracy);
+    ASSERT_NEAR(quantiles.quantile(0.99), 4990.0, 4990.0 * accuracy);
+    ASSERT_NEAR(quantiles.quantile(0.0), 4001.0, 4001.0 * accuracy);
+}
+
+TEST(ConcurrentCirtucalBufferExtTestSuite, GrowthTest) {
+    CConcurrentCirtucalBufferExt<std::string> buff(4);
+    std::string val;
+    ASSERT_TRUE(buff.empty());
+    ASSERT_FALSE(buff.try_pop_front(val));
+
+    for (int i = 0; i < 100; i++) {
+        buff.push_back(std::to_string(i));
+    }
+    ASSERT_EQ(buff.segments_allocated(), 25);
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(buff.try_pop_front(val));
+        ASSERT_EQ(val, std::to_string(i));
+    }
+    ASSERT_TRUE(buff.empty());
+
+    // drained segments come back through the free list
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 10; i++) {
+            buff.push_back("x");
+        }
+        for (int i = 0; i < 10; i++) {
+            ASSERT_TRUE(buff.try_pop_front(val));
+        }
+    }
+    ASSERT_LE(buff.segments_allocated(), 30);
+
+    buff.push_back("left in the queue");
+}
+
+TEST(ConcurrentCirtucalBufferExtTestSuite, MultiProducerTest) {
+    const int producers_count = 4;
+    const int count = 20000;
+    CConcurrentCirtucalBufferExt<long> buff(64);
+
+    std::thread producers[producers_count];
+    for (int p = 0; p < producers_count; p++) {
+        producers[p] = std::thread([&buff, p]() {
+            for (long i = 0; i < count; i++) {
+                buff.push_back(p * count + i);
+            }
+        });
+    }
+
+    long next[producers_count] = {};
+    bool ordered = true;
+    long val = 0;
+    for (int received = 0; received < producers_count * count;) {
+        if (!buff.try_pop_front(val)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        long p = val / count;
+        ordered = ordered && val % count == next[p]++;
+        ++received;
+    }
+
+    for (std::thread& producer: producers) {
+        producer.join();
+    }
+
+    ASSERT_TRUE(ordered);
+    ASSERT_TRUE(buff.empty());
+    for (long n: next) {
+        ASSERT_EQ(n, count);
+    }
+}
+
+TEST(ChunkedCirtucalBufferExtTestSuite, BufferExtTest) {
+    using Buffer = CChunkedCirtucalBufferExt<int, 2>;
+    Buffer buff({1, 2, 3});
+
+    ASSERT_EQ(buff.size(), 3);
+    ASSERT_EQ(buff.capacity(), 3);
+
+    buff.push_back(4);
+    ASSERT_EQ(buff.size(), 4);
+    ASSERT_EQ(buff.capacity(), 6);
+
+    buff.push_front(5);
+    buff.push_front(6);
+    buff.push_front(7);
+    ASSERT_EQ(buff.size(), 7);
+    ASSERT_EQ(buff.capacity(), 12);
+
+    ASSERT_EQ(buff, Buffer({7, 6, 5, 1, 2, 3, 4}));
+    ASSERT_EQ(buff[3], 1);
+    ASSERT_THROW(buff[7], std::out_of_range);
+
+    std::sort(buff.begin(), buff.end());
+    ASSERT_EQ(buff, Buffer({1, 2, 3, 4, 5, 6, 7}));
+
+    ASSERT_EQ(*buff.insert(2, 0), 0);
+    ASSERT_EQ(*buff.erase(buff.begin() + 4, buff.begin() + 6), 6);
+    ASSERT_EQ(buff, Buffer({1, 2, 0, 3, 6, 7}));
+    ASSERT_EQ(buff.erase(buff.end()), buff.end());
+
+    Buffer other({9});
+    buff.swap(other);
+    buff.resize(3);
+    ASSERT_EQ(buff, Buffer({9, 0, 0}));
+    ASSERT_EQ(other.size(), 6);
+}
+
+TEST(ChunkedCirtucalBufferExtTestSuite, StableReferencesTest) {
+    CChunkedCirtucalBufferExt<std::string, 3> buff(1);
+    buff.push_back("first");
+    const std::string* first = &buff.front();
+
+    for (int i = 0; i < 1000; i++) {
+        buff.push_back(std::to_string(i));
+    }
+    ASSERT_EQ(&buff.front(), first);
+    ASSERT_EQ(buff.capacity(), 1024);
+    ASSERT_EQ(buff.chunks(), 126);
+    ASSERT_EQ(buff.back(), "999");
+
+    for (int i = 0; i < 500; i++) {
+        buff.pop_front();
+    }
+    ASSERT_EQ(buff.front(), "499");
+    ASSERT_EQ(buff.pooled_chunks(), 62);
+
+    const std::string* last = &buff.back();
+    for (int i = 0; i < 400; i++) {
+        buff.push_back("again");
+    }
+    ASSERT_EQ(*last, "999");
+    ASSERT_EQ(buff.pooled_chunks(), 12);
+
+    CChunkedCirtucalBufferExt<std::string, 3> copy = buff;
+    ASSERT_EQ(copy, buff);
+
+    buff.clear();
+    ASSERT_TRUE(buff.empty());
+    ASSERT_EQ(buff.chunks(), 0);
+    buff.shrink_to_fit();
+    ASSERT_EQ(buff.pooled_chunks(), 0);
+}
+
+
+TEST(PipelineTestSuite, StagesTest) {
+    std::vector<double> out;
+    CPipeline<int> pipeline = make_pipeline<int>(8, 4)
+        .stage([](int x) { return x * 2; })
+        .stage([](int x) { return x / 4.0; })
+        .sink([&out](double x) { out.push_back(x); });
+    ASSERT_EQ(pipeline.stages(), 3);
+
+    pipeline.start();
+    for (int i = 0; i < 1000; i++) {
+        pipeline.push(i);
+    }
+    pipeline.close();
+    pipeline.wait();
+
+    ASSERT_EQ(out.size(), 1000);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(out[i], i / 2.0);
+    }
+
+    for (size_t i = 0; i < pipeline.stages(); i++) {
+        CStageMetrics metrics = pipeline.stage_metrics(i);
+        ASSERT_EQ(metrics.processed, 1000);
+        ASSERT_EQ(metrics.queue_depth, 0);
+        ASSERT_GT(metrics.throughput, 0);
+    }
+    ASSERT_THROW(pipeline.stage_metrics(3), std::out_of_range);
+}
+
+TEST(PipelineTestSuite, NonTrivialStageTest) {
+    size_t total = 0;
+    size_t count = 0;
+    CPipeline<int> pipeline = make_pipeline<int>(8, 4)
+        .stage([](int x) { return std::string(100 + x % 7, 'a'); })
+        .sink([&](const std::string& s) {
+            total += s.size();
+            ++count;
+        });
+
+    pipeline.start();
+    for (int i = 0; i < 100; i++) {
+        pipeline.push(i);
+    }
+    pipeline.close();
+    pipeline.wait();
+
+    size_t expected = 0;
+    for (int i = 0; i < 100; i++) {
+        expected += 100 + i % 7;
+    }
+    ASSERT_EQ(count, 100);
+    ASSERT_EQ(total, expected);
+
+    ASSERT_THROW(make_pipeline<int>(8, 0), std::invalid_argument);
+    ASSERT_THROW(make_pipeline<int>(0, 4), std::invalid_argument);
+}
+
+TEST(PipelineTestSuite, BackpressureTest) {
+    std::atomic<bool> blocked{true};
+    std::atomic<long> sum{0};
+    CPipeline<int> pipeline = make_pipeline<int>(4, 2)
+        .stage([&blocked](int x) {
+            while (blocked.load()) {
+                std::this_thread::yield();
+            }
+            return x + 1;
+        }, 0)
+        .sink([&sum](int x) { sum += x; });
+    pipeline.start();
+
+    // the first stage holds its claimed batch, so the input ring fills up and stays full.
+    // nothing is asserted while the stage is blocked, a failure would hang the teardown
+    int pushed = 0;
+    while (pushed < 10 && pipeline.try_push(pushed)) {
+        ++pushed;
+    }
+    size_t depth = pipeline.stage_metrics(0).queue_depth;
+    size_t processed = pipeline.stage_metrics(1).processed;
+
+    blocked = false;
+    for (int i = pushed; i < 10; i++) {
+        pipeline.push(i);
+    }
+    pipeline.close();
+    pipeline.wait();
+
+    ASSERT_EQ(pushed, 4);
+    ASSERT_EQ(depth, 4);
+    ASSERT_EQ(processed, 0);
+    ASSERT_EQ(sum.load(), 55);
+}
+
+
+TEST(TombstoneCirtucalBufferTestSuite, EraseTest) {
+    CTombstoneCirtucalBuffer<int> buff(8, 1.0);
+    for (int i = 0; i < 8; i++) {
+        buff.push_back(i);
+    }
+
+    auto it = std::next(buff.begin(), 3);
+    auto kept = std::next(buff.begin(), 5);
+    it = buff.erase(it);
+    ASSERT_EQ(*it, 4);
+    it = buff.erase(it);
+    ASSERT_EQ(*it, 5);
+    ASSERT_EQ(*kept, 5);
+    ASSERT_EQ(buff.size(), 6);
+    ASSERT_EQ(buff.tombstones(), 2);
+    ASSERT_EQ(std::vector<int>(buff.begin(), buff.end()), std::vector<int>({0, 1, 2, 5, 6, 7}));
+    ASSERT_EQ(*std::prev(kept), 2);
+
+    buff.erase(buff.begin());
+    buff.erase(std::prev(buff.end()));
+    ASSERT_EQ(buff.front(), 1);
+    ASSERT_EQ(buff.back(), 6);
+
+    // dead slots uncovered at the head cost nothing
+    buff.pop_front();
+    buff.pop_front();
+    ASSERT_EQ(buff.front(), 5);
+    ASSERT_EQ(buff.size(), 2);
+    ASSERT_EQ(buff.tombstones(), 0);
+
+    buff.pop_front();
+    buff.pop_back();
+    ASSERT_TRUE(buff.empty());
+    ASSERT_THROW(buff.pop_front(), std::out_of_range);
+}
+
+TEST(TombstoneCirtucalBufferTestSuite, EraseGuardsTest) {
+    CTombstoneCirtucalBuffer<int> buff({1, 2, 3, 4});
+
+    ASSERT_EQ(buff.erase(buff.end()), buff.end());
+    ASSERT_EQ(buff.size(), 4);
+
+    auto dead = std::next(buff.begin());
+    buff.erase(dead);
+    ASSERT_THROW(buff.erase(dead), std::out_of_range);
+    ASSERT_EQ(buff.size(), 3);
+    ASSERT_EQ(buff.tombstones(), 1);
+    ASSERT_EQ(std::vector<int>(buff.begin(), buff.end()), std::vector<int>({1, 3, 4}));
+
+    const CTombstoneCirtucalBuffer<int>& view = buff;
+    static_assert(std::is_same_v<decltype(*view.begin()), const int&>);
+    static_assert(std::is_same_v<decltype(view.front()), const int&>);
+    CTombstoneCirtucalBuffer<int>::const_iterator first = buff.begin();
+    ASSERT_EQ(first, view.begin());
+
+    CTombstoneCirtucalBuffer<int> single(4);
+    single.push_back(7);
+    single.pop_back();
+    ASSERT_TRUE(single.empty());
+    single.push_back(8);
+    ASSERT_EQ(single.front(), 8);
+    ASSERT_EQ(single.size(), 1);
+}
+
+TEST(TombstoneCirtucalBufferTestSuite, CompactionTest) {
+    CTombstoneCirtucalBuffer<std::string> buff(10);
+    for (int i = 0; i < 10; i++) {
+        buff.push_back(std::to_string(i));
+    }
+
+    // every odd element goes, the last one without a tombstone
+    for (auto it = buff.begin(); it != buff.end();) {
+        if (std::stoi(*it) % 2 == 1) {
+            it = buff.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ASSERT_EQ(buff.size(), 5);
+    ASSERT_EQ(buff.tombstones(), 4);
+    ASSERT_EQ(std::vector<std::string>(buff.begin(), buff.end()),
+              std::vector<std::string>({"0", "2", "4", "6", "8"}));
+
+    // the fifth tombstone out of nine slots crosses the threshold
+    auto it = buff.erase(std::next(buff.begin()));
+    ASSERT_EQ(*it, "4");
+    ASSERT_EQ(buff.tombstones(), 0);
+    ASSERT_EQ(std::vector<std::string>(buff.begin(), buff.end()),
+              std::vector<std::string>({"0", "4", "6", "8"}));
+
+    buff.erase(std::next(buff.begin(), 2));
+    ASSERT_EQ(buff.tombstones(), 1);
+
+    // a full ring reuses the dead slots before it starts overwriting
+    for (int i = 10; i < 17; i++) {
+        buff.push_back(std::to_string(i));
+    }
+    ASSERT_TRUE(buff.full());
+    ASSERT_EQ(buff.front(), "0");
+    ASSERT_EQ(buff.tombstones(), 0);
+
+    buff.push_back("17");
+    ASSERT_EQ(buff.front(), "4");
+    ASSERT_EQ(buff.back(), "17");
+    ASSERT_EQ(buff.size(), 10);
+
+    CTombstoneCirtucalBuffer<std::string> copy = buff;
+    ASSERT_EQ(copy, buff);
+}
+
+
+TEST(CompressedCirtucalBufferTestSuite, TimestampsTest) {
+    CCompressedCirtucalBuffer<int64_t> buff(4096, 128);
+    CCirtucalBuffer<int64_t> plain(4096 / sizeof(int64_t));
+
+    int64_t time = 1700000000000000;
+    for (int i = 0; i < 100000; i++) {
+        time += 900 + (i * 7919) % 200;
+        buff.push_back(time);
+        plain.push_back(time);
+    }
+
+    // two bytes per timestamp instead of eight, minus the partly filled blocks
+    ASSERT_EQ(buff.blocks(), buff.block_capacity());
+    ASSERT_GT(buff.size(), 3 * plain.size());
+    ASSERT_EQ(buff.back(), time);
+
+    size_t offset = plain.size() - 1;
+    std::vector<int64_t> decoded(buff.begin(), buff.end());
+    ASSERT_EQ(decoded.size(), buff.size());
+    for (size_t i = 0; i < plain.size(); i++) {
+        ASSERT_EQ(decoded[decoded.size() - 1 - i], plain[offset - i]);
+        ASSERT_EQ(buff[buff.size() - 1 - i], plain[offset - i]);
+    }
+    ASSERT_THROW(buff.at(buff.size()), std::out_of_range);
+}
+
+TEST(CompressedCirtucalBufferTestSuite, SignedDeltasTest) {
+    CCompressedCirtucalBuffer<int32_t> buff(64, 16);
+    std::vector<int32_t> values = {0, -1, 1, INT32_MIN, INT32_MAX, 5, 5, 5, -300, 70000, 3};
+    for (int32_t val: values) {
+        buff.push_back(val);
+    }
+    ASSERT_EQ(std::vector<int32_t>(buff.begin(), buff.end()), values);
+    ASSERT_EQ(buff.front(), 0);
+
+    size_t dropped = buff.pop_front_block();
+    ASSERT_EQ(buff.size(), values.size() - dropped);
+    ASSERT_EQ(buff.front(), values[dropped]);
+    for (size_t i = 0; i < buff.size(); i++) {
+        ASSERT_EQ(buff[i], values[dropped + i]);
+    }
+
+    buff.clear();
+    ASSERT_TRUE(buff.empty());
+    ASSERT_EQ(buff.begin(), buff.end());
+    ASSERT_THROW(CCompressedCirtucalBuffer<int64_t>(64, 4), std::invalid_argument);
+}
+
+
+TEST(TimerWheelTestSuite, ScheduleCancelTest) {
+    CTimerWheel<int> wheel(4, 2, 2);
+    CTimerHandle first = wheel.schedule(3, 1);
+    CTimerHandle second = wheel.schedule(3, 2);
+    CTimerHandle third = wheel.schedule(0, 3);
+    ASSERT_EQ(wheel.size(), 3);
+
+    ASSERT_TRUE(wheel.cancel(second));
+    ASSERT_FALSE(wheel.cancel(second));
+    ASSERT_FALSE(wheel.active(second));
+
+    std::vector<int> fired;
+    ASSERT_EQ(wheel.advance(1, [&](int id) { fired.push_back(id); }), 1);
+    ASSERT_EQ(fired, std::vector<int>({3}));
+    ASSERT_FALSE(wheel.cancel(third));
+
+    // the freed node is reused, the old handle stays dead
+    CTimerHandle reused = wheel.schedule(1, 4);
+    ASSERT_EQ(reused.index, third.index);
+    ASSERT_FALSE(wheel.active(third));
+    ASSERT_TRUE(wheel.active(reused));
+
+    wheel.advance(2, [&](int id) { fired.push_back(id); });
+    ASSERT_EQ(fired, std::vector<int>({3, 4, 1}));
+    ASSERT_TRUE(wheel.empty());
+    ASSERT_FALSE(wheel.active(first));
+
+    for (int i = 0; i < 4; i++) {
+        wheel.schedule(1, i);
+    }
+    ASSERT_THROW(wheel.schedule(1, 4), std::length_error);
+}
+
+TEST(TimerWheelTestSuite, CascadeTest) {
+    // 16 slots over 2 levels cover 256 ticks, longer timers are parked and re-placed
+    CTimerWheel<uint64_t> wheel(1000, 4, 2);
+    std::vector<CTimerHandle> handles;
+    for (uint64_t delay = 1; delay <= 1000; delay++) {
+        handles.push_back(wheel.schedule((delay * 7919) % 1000 + 1, (delay * 7919) % 1000 + 1));
+    }
+    for (size_t i = 0; i < handles.size(); i += 10) {
+        ASSERT_TRUE(wheel.cancel(handles[i]));
+    }
+
+    size_t count = 0;
+    bool on_time = true;
+    for (int step = 0; step < 100; step++) {
+        count += wheel.advance(11, [&](uint64_t due) {
+            on_time = on_time && due == wheel.now();
+        });
+    }
+    ASSERT_TRUE(on_time);
+    ASSERT_EQ(count, 900);
+    ASSERT_TRUE(wheel.empty());
+}
+
+
+TEST(CirtucalBufferViewTestSuite, RangesTest) {
+    static_assert(std::ranges::view<CCirtucalBufferView<int>>);
+    static_assert(std::ranges::random_access_range<CCirtucalBufferView<int>>);
+    static_assert(std::ranges::sized_range<CCirtucalBufferView<int>>);
+    static_assert(std::ranges::borrowed_range<CCirtucalBufferView<const int>>);
+    static_assert(std::is_same_v<decltype(CCirtucalBuffer<int>().view()), decltype(CCirtucalBuffer<int>().segments())>);
+    static_assert(std::is_same_v<decltype(CCirtucalBuffer<int>().view()), decltype(CCirtucalBuffer<int>().range(0, 1))>);
+
+    CCirtucalBuffer<int> buff(6);
+    for (int i = 0; i < 9; i++) {
+        buff.push_back(i);
+    }
+    ASSERT_NE(buff.segments().second().size(), 0);
+
+    CCirtucalBufferView<const int> view(buff);
+    ASSERT_EQ(view.size(), 6);
+    ASSERT_EQ(view.front(), 3);
+    ASSERT_EQ(view[5], 8);
+
+    auto slice = view.subview(1, 5);
+    ASSERT_EQ(std::vector<int>(slice.begin(), slice.end()), std::vector<int>({4, 5, 6, 7}));
+    ASSERT_EQ(slice.last(2).front(), 6);
+    ASSERT_THROW(slice.subview(2, 6), std::out_of_range);
+
+    auto odd = view | std::views::filter([](int x) { return x % 2 == 1; });
+    ASSERT_EQ(std::vector<int>(odd.begin(), odd.end()), std::vector<int>({3, 5, 7}));
+    ASSERT_EQ(*std::ranges::max_element(buff.view().first(3)), 5);
+
+    // no copy, the view sees the writes
+    buff.view()[0] = 42;
+    ASSERT_EQ(buff.front(), 42);
+}
+
+TEST(CirtucalBufferViewTestSuite, EqualityHashTest) {
+    CCirtucalBuffer<int> wrapped(5);
+    for (int i = 0; i < 8; i++) {
+        wrapped.push_back(i);
+    }
+    CCirtucalBuffer<int> straight = {3, 4, 5, 6, 7};
+    ASSERT_EQ(wrapped, straight);
+    ASSERT_EQ(wrapped.view().hash(), straight.view().hash());
+    ASSERT_EQ(std::hash<CCirtucalBufferView<int>>()(wrapped.view()), straight.view().hash());
+
+    // the sizes have to match too, a longer buffer is not equal to its prefix
+    CCirtucalBuffer<int> longer = {3, 4, 5, 6, 7, 8};
+    ASSERT_NE(straight, longer);
+    ASSERT_NE(longer, straight);
+    ASSERT_EQ(longer.view().first(5), wrapped.view());
+
+    straight.push_back(9);
+    ASSERT_NE(wrapped, straight);
+    ASSERT_NE(wrapped.view().hash(), straight.view().hash());
+
+    // +0.0 and -0.0 differ in bytes, so doubles go element by element
+    CCirtucalBuffer<double> zeros = {0.0, 1.5};
+    CCirtucalBuffer<double> negative_zeros = {-0.0, 1.5};
+    ASSERT_EQ(zeros, negative_zeros);
+    ASSERT_EQ(zeros.view().hash(), negative_zeros.view().hash());
+}